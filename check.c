@@ -1,16 +1,10 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "param.h"
+#include "sysstat.h"
 #include "fs.h"
 
-struct procstat{
-  int pid;
-  int runtime;
-  int num_run;
-  int current_queue;
-  int ticks[5];
-};
-
 int main (int argc,char *argv[])
 {
 
@@ -29,6 +23,9 @@ int main (int argc,char *argv[])
         printf(1,"Num Run%d\n",curproc.num_run);
         printf(1,"Current Queue%d\n",curproc.current_queue);
         for(int i=0;i<5;++i)    printf(1,"Ticks %d in queue %d\n",curproc.ticks[i],i);
+        printf(1,"CPU %d Migrations %d Steals %d\n",curproc.cpu,curproc.migrations,curproc.steals);
+        printf(1,"User %d us System %d us Wait %d us\n",curproc.utime,curproc.stime,curproc.wtime);
+        printf(1,"Inversions %d for %d us\n",curproc.inversions,curproc.invtime);
 //        status=waitx(&x,&y);
 //        printf(1, "Wait Time = %d\n Run Time = %d\n Status: %d \n", x, y, status); 
 
@@ -0,0 +1,26 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "sysstat.h"
+
+// Print the scheduler counters of each CPU.
+int
+main(int argc, char *argv[])
+{
+  struct cpustat st[8];
+  int i, n;
+
+  n = cpustat(st, 8);
+  if(n < 0){
+    printf(2, "cpus: cpustat failed\n");
+    exit();
+  }
+  printf(1, "cpu\tidle ms\thalts\tipis\tsteals\tmigrations\tkalloc\tkfree\n");
+  for(i = 0; i < n; i++)
+    printf(1, "%d%s\t%d\t%d\t%d\t%d\t%d\t\t%d\t%d\n", st[i].cpu,
+           st[i].tickless ? "*" : "", st[i].idlems, st[i].halts,
+           st[i].ipis, st[i].steals, st[i].migrations,
+           st[i].kallocs, st[i].kfrees);
+  exit();
+}
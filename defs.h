@@ -1,15 +1,25 @@
 struct buf;
 struct context;
+struct fdtable;
 struct file;
 struct inode;
 struct pipe;
 struct proc;
+struct rbnode;
+struct rbroot;
 struct rtcdate;
+struct runq;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
 struct procstat;
+struct cpustat;
+struct pinfo;
+struct latstat;
+struct memstat;
+struct slabcache;
+struct slabstat;
 
 // bio.c
 void            binit(void);
@@ -27,6 +37,14 @@ void            panic(char*) __attribute__((noreturn));
 int             exec(char*, char**);
 
 // file.c
+struct file*    fdclose(int);
+int             fdalloc(struct file*);
+struct inode*   fdcwd(void);
+struct file*    fdget(int);
+struct inode*   fdsetcwd(struct inode*);
+struct fdtable* fdtalloc(struct fdtable*);
+void            fdtput(struct fdtable*);
+struct fdtable* fdtshare(struct fdtable*);
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
@@ -41,6 +59,7 @@ int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            icacheinit(void);
 void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -66,9 +85,15 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+char*           kalloc_order(int);
+void            kdup(char*);
 void            kfree(char*);
+void            kfree_order(char*, int);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kmemstat(struct memstat*);
+int             krefs(char*);
+void            kstat(int, uint*, uint*);
 
 // kbd.c
 void            kbdintr(void);
@@ -78,6 +103,8 @@ void            cmostime(struct rtcdate *r);
 int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
+void            lapicipi(int, int);
+void            lapictimer(int);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
@@ -99,15 +126,20 @@ void            picinit(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
+void            pipeinit(void);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
 // proc.c
+int             clone(void (*)(void*), void*, void*);
 int             cpuid(void);
 void            exit(void);
 int             fork(void);
+int             futexwait(uint, uint);
+int             futexwake(uint, int);
 int             growproc(int);
+int             join(void**);
 int             kill(int);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
@@ -119,12 +151,59 @@ void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
-int             waitx(int *, int *); 
+int             waitx(int*, int*, struct procstat*);
+uint64          tsccharge(struct proc*, uint64*);
 void            wakeup(void*);
+void            wakeone(void*);
 void            yield(void);
-int             cps(void);
+int             yieldto(int);
 int             cpr(int pid, int priority);
+int             settickets(int pid, int tickets);
+int             gettickets(int pid);
 int             getpinfo(struct procstat*);
+int             cpustat(struct cpustat*, int);
+int             getprocs(uint, int);
+int             latstat(int, int, struct latstat*);
+
+// rbtree.c
+void            rberase(struct rbroot*, struct rbnode*);
+void            rbinsert(struct rbroot*, struct rbnode*,
+                         int (*)(struct rbnode*, struct rbnode*));
+struct rbnode*  rblast(struct rbroot*);
+struct rbnode*  rbnext(struct rbnode*);
+struct rbnode*  rbprev(struct rbnode*);
+
+// runq.c
+void            rqcharge(struct proc*, uint, uint64);
+void            rqdequeue(struct runq*, struct proc*);
+void            rqdrain(struct proc*);
+void            rqenqueue(struct runq*, struct proc*);
+void            rqidle(struct runq*);
+void            rqinherit(struct proc*, int, int);
+void            rqinit(void);
+void            rqlatency(struct runq*, struct proc*, uint64);
+void            rqlatsum(int, uint*, uint*);
+int             rqlevel(struct proc*);
+struct runq*    rqlock(void);
+struct runq*    rqlockproc(struct proc*);
+int             rqoutranks(struct proc*, struct proc*);
+struct proc*    rqpick(struct runq*);
+int             rqplace(void);
+int             rqprio(struct proc*);
+void            rqready(struct proc*);
+int             rqsetpolicy(int);
+int             rqsetrt(struct proc*, int, int, int);
+int             rqsteal(struct runq*);
+int             rqtake(struct proc*);
+int             rqtick(struct proc*);
+void            rqyield(struct proc*);
+
+// slab.c
+void*           slaballoc(struct slabcache*);
+struct slabcache* slabcreate(char*, uint);
+void            slabfree(struct slabcache*, void*);
+void            slabinit(void);
+int             slabstat(int, struct slabstat*);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -143,6 +222,7 @@ void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            sleeplockinit(void);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -155,14 +235,25 @@ char*           strncpy(char*, const char*, int);
 
 // syscall.c
 int             argint(int, int*);
-int             argptr(int, char**, int);
+int             argptr(int, char**, int, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
+int             nanosleep(int, int);
 void            timerinit(void);
+int             timersleep(int);
+void            timertick(void);
+uint            tscfrac(uint64);
+uint            tscus(uint64);
+extern uint     tscpertick;
+
+// trace.c
+void            trace(int, struct proc*, int);
+void            traceinit(void);
+int             traceread(uint, int);
 
 // trap.c
 void            idtinit(void);
@@ -186,9 +277,14 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             uvmfault(pde_t*, uint, uint, int);
+int             uvmtouch(pde_t*, uint, uint, uint, int);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
-int             copyout(pde_t*, uint, void*, uint);
+int             copyout(pde_t*, uint, uint, void*, uint);
+void            shrinkuvm(pde_t*, uint, uint);
+void            tlbintr(void);
+void            tlbshootdown(pde_t*);
 void            clearpteu(pde_t *pgdir, char *uva);
 
 // number of elements in fixed-size array
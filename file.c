@@ -5,6 +5,8 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "mmu.h"
+#include "proc.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
@@ -12,32 +14,175 @@
 
 struct devsw devsw[NDEV];
 struct {
-  struct spinlock lock;
-  struct file file[NFILE];
+  struct spinlock lock;        // protects file reference counts
+  struct slabcache *cache;
+  struct slabcache *fdtcache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  ftable.cache = slabcreate("file", sizeof(struct file));
+  ftable.fdtcache = slabcreate("fdtable", sizeof(struct fdtable));
 }
 
-// Allocate a file structure.
+// Allocate a descriptor table holding new references to
+// the open files and directory of old, or one with no
+// files open in the root directory if old is 0.
+struct fdtable*
+fdtalloc(struct fdtable *old)
+{
+  struct fdtable *t;
+  int fd;
+
+  if((t = slaballoc(ftable.fdtcache)) == 0)
+    return 0;
+  memset(t, 0, sizeof(*t));
+  initlock(&t->lock, "fdtable");
+  t->ref = 1;
+  if(old){
+    acquire(&old->lock);
+    for(fd = 0; fd < NOFILE; fd++)
+      if(old->ofile[fd])
+        t->ofile[fd] = filedup(old->ofile[fd]);
+    t->cwd = idup(old->cwd);
+    release(&old->lock);
+  } else
+    t->cwd = namei("/");
+  return t;
+}
+
+// Share descriptor table t with one more process.
+struct fdtable*
+fdtshare(struct fdtable *t)
+{
+  acquire(&t->lock);
+  t->ref++;
+  release(&t->lock);
+  return t;
+}
+
+// Drop a process's use of descriptor table t, closing
+// its files and directory when no process uses it.
+void
+fdtput(struct fdtable *t)
+{
+  int fd;
+
+  acquire(&t->lock);
+  if(--t->ref > 0){
+    release(&t->lock);
+    return;
+  }
+  release(&t->lock);
+
+  for(fd = 0; fd < NOFILE; fd++)
+    if(t->ofile[fd])
+      fileclose(t->ofile[fd]);
+  if(t->cwd){
+    begin_op();
+    iput(t->cwd);
+    end_op();
+  }
+  slabfree(ftable.fdtcache, t);
+}
+
+// Return open file fd of the current process with a new
+// reference, which the caller drops with fileclose(), since
+// a thread sharing the table may close fd meanwhile.
 struct file*
-filealloc(void)
+fdget(int fd)
 {
+  struct fdtable *t = myproc()->fdt;
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&t->lock);
+  if((f = t->ofile[fd]) != 0)
+    filedup(f);
+  release(&t->lock);
+  return f;
+}
+
+// Allocate a file descriptor for the given file.
+// Takes over file reference from caller on success.
+int
+fdalloc(struct file *f)
+{
+  struct fdtable *t = myproc()->fdt;
+  int fd;
+
+  acquire(&t->lock);
+  for(fd = 0; fd < NOFILE; fd++){
+    if(t->ofile[fd] == 0){
+      t->ofile[fd] = f;
+      release(&t->lock);
+      return fd;
     }
   }
-  release(&ftable.lock);
-  return 0;
+  release(&t->lock);
+  return -1;
+}
+
+// Free file descriptor fd and return its file, whose
+// reference passes to the caller, or 0 if fd is not open.
+struct file*
+fdclose(int fd)
+{
+  struct fdtable *t = myproc()->fdt;
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&t->lock);
+  f = t->ofile[fd];
+  t->ofile[fd] = 0;
+  release(&t->lock);
+  return f;
+}
+
+// Return the current directory with a new reference.
+struct inode*
+fdcwd(void)
+{
+  struct fdtable *t = myproc()->fdt;
+  struct inode *ip;
+
+  acquire(&t->lock);
+  ip = idup(t->cwd);
+  release(&t->lock);
+  return ip;
+}
+
+// Make ip, whose reference passes to the table, the
+// current directory, and return the old one for the
+// caller to iput().
+struct inode*
+fdsetcwd(struct inode *ip)
+{
+  struct fdtable *t = myproc()->fdt;
+  struct inode *old;
+
+  acquire(&t->lock);
+  old = t->cwd;
+  t->cwd = ip;
+  release(&t->lock);
+  return old;
+}
+
+// Allocate a file structure.
+struct file*
+filealloc(void)
+{
+  struct file *f;
+
+  if((f = slaballoc(ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -66,9 +211,8 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
   release(&ftable.lock);
+  slabfree(ftable.cache, f);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -1,3 +1,12 @@
+// Open files and current directory of a process,
+// shared with its threads.
+struct fdtable {
+  struct spinlock lock;        // protects the fields below
+  int ref;                     // Processes sharing the table
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+};
+
 struct file {
   enum { FD_NONE, FD_PIPE, FD_INODE } type;
   int ref; // reference count
@@ -14,6 +23,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // On icache's list
+  struct inode *prev;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
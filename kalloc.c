@@ -1,6 +1,12 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, or blocks of
+// 2^n physically contiguous pages.
+//
+// Free memory is kept by a binary buddy allocator: a free
+// block of 2^n pages starts on a multiple of 2^n pages, and
+// when it is freed next to its equal-sized buddy the two are
+// merged into one block of twice the size.
 
 #include "types.h"
 #include "defs.h"
@@ -8,6 +14,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "spinlock.h"
+#include "sysstat.h"
 
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
@@ -15,14 +22,47 @@ extern char end[]; // first address after kernel loaded from ELF file
 
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  struct run *free[NORDER];    // Free blocks of 2^n pages
+  uint nfree[NORDER];          // Number of them
+  uint fails[NORDER];          // Allocations of 2^n pages that failed
 } kmem;
 
+// kpage[n] is k+1 if physical page n starts a free block
+// of 2^k pages, and 0 otherwise.
+static uchar kpage[PHYSTOP/PGSIZE];
+
+// kref[n] counts the references to physical page n beyond
+// the first, taken by copy-on-write fork.  kfree() drops one
+// and frees the page only when there are none; a page with
+// a single owner never touches reflock.
+static ushort kref[PHYSTOP/PGSIZE];
+static struct spinlock reflock;
+
+// Once the other CPUs are up, each CPU keeps a cache of
+// free pages that it allocates from and frees to without
+// locking, so CPUs do not contend on kmem.lock or bounce
+// its cache line.  An empty cache refills from kmem with
+// KBATCH pages, and a cache past 2*KBATCH pages gives
+// KBATCH back.  Pages in one CPU's cache are not seen by
+// the others, so kalloc() can fail with up to that many
+// pages free per CPU.
+#define KBATCH 16
+
+struct kcache {
+  struct run *freelist;
+  int nfree;
+  uint allocs;                 // kalloc() calls on this CPU
+  uint frees;                  // kfree() calls on this CPU
+} __attribute__((aligned(64)));
+
+static struct kcache kcache[NCPU];
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -32,6 +72,7 @@ void
 kinit1(void *vstart, void *vend)
 {
   initlock(&kmem.lock, "kmem");
+  initlock(&reflock, "kref");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -51,29 +92,134 @@ freerange(void *vstart, void *vend)
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
     kfree(p);
 }
+
+// The buddy lists.  Callers hold kmem.lock once it is in use.
+
+static void
+blockinsert(char *v, int order)
+{
+  struct run *r = (struct run*)v;
+
+  r->prev = 0;
+  r->next = kmem.free[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[order] = r;
+  kmem.nfree[order]++;
+  kpage[V2P(v)/PGSIZE] = order+1;
+}
+
+static void
+blockremove(char *v, int order)
+{
+  struct run *r = (struct run*)v;
+
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree[order]--;
+  kpage[V2P(v)/PGSIZE] = 0;
+}
+
+// Take a block of 2^order pages, splitting a larger one
+// if need be.  Return 0 if there is none.
+static char*
+buddyalloc(int order)
+{
+  char *v;
+  int k;
+
+  for(k = order; k < NORDER && kmem.free[k] == 0; k++)
+    ;
+  if(k == NORDER)
+    return 0;
+  v = (char*)kmem.free[k];
+  blockremove(v, k);
+  while(k > order){
+    k--;
+    blockinsert(v + (PGSIZE << k), k);
+  }
+  return v;
+}
+
+// Free the block of 2^order pages at v, merging it
+// with its buddy for as long as that is free too.
+static void
+buddyfree(char *v, int order)
+{
+  uint pn, buddy;
+
+  pn = V2P(v)/PGSIZE;
+  for(; order < NORDER-1; order++){
+    buddy = pn ^ (1 << order);
+    if(buddy >= PHYSTOP/PGSIZE || kpage[buddy] != order+1)
+      break;
+    blockremove(P2V(buddy*PGSIZE), order);
+    pn &= ~(1 << order);
+  }
+  blockinsert(P2V(pn*PGSIZE), order);
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
+// If the page is shared, just drop a reference.
 void
 kfree(char *v)
 {
-  struct run *r;
+  struct kcache *kc;
+  struct run *r, *next;
+  uint pn;
+  int i;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  pn = V2P(v)/PGSIZE;
+  if(kref[pn]){
+    acquire(&reflock);
+    if(kref[pn]){
+      kref[pn]--;
+      release(&reflock);
+      return;
+    }
+    release(&reflock);
+  }
+
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
+  if(!kmem.use_lock){
+    buddyfree(v, 0);
+    return;
+  }
+
+  pushcli();
+  kc = &kcache[cpuid()];
+  kc->frees++;
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
+  r->next = kc->freelist;
+  kc->freelist = r;
+  if(++kc->nfree > 2*KBATCH){
+    // Give the oldest KBATCH back.
+    for(r = kc->freelist, i = 1; i < kc->nfree - KBATCH; i++)
+      r = r->next;
+    next = r->next;
+    r->next = 0;
+    acquire(&kmem.lock);
+    for(r = next; r; r = next){
+      next = r->next;
+      buddyfree((char*)r, 0);
+    }
     release(&kmem.lock);
+    kc->nfree -= KBATCH;
+  }
+  popcli();
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -82,15 +228,124 @@ kfree(char *v)
 char*
 kalloc(void)
 {
+  struct kcache *kc;
   struct run *r;
 
+  if(!kmem.use_lock)
+    return buddyalloc(0);
+
+  pushcli();
+  kc = &kcache[cpuid()];
+  if(kc->freelist == 0){
+    acquire(&kmem.lock);
+    while(kc->nfree < KBATCH && (r = (struct run*)buddyalloc(0)) != 0){
+      r->next = kc->freelist;
+      kc->freelist = r;
+      kc->nfree++;
+    }
+    if(kc->freelist == 0)
+      kmem.fails[0]++;
+    release(&kmem.lock);
+  }
+  if((r = kc->freelist) != 0){
+    kc->freelist = r->next;
+    kc->nfree--;
+    kc->allocs++;
+  }
+  popcli();
+  return (char*)r;
+}
+
+// Allocate 2^order physically contiguous pages, aligned
+// to their size.  Returns 0 if they cannot be allocated.
+char*
+kalloc_order(int order)
+{
+  char *v;
+
+  if(order < 0 || order >= NORDER)
+    return 0;
+  if(order == 0)
+    return kalloc();
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  if((v = buddyalloc(order)) == 0)
+    kmem.fails[order]++;
   if(kmem.use_lock)
     release(&kmem.lock);
-  return (char*)r;
+  return v;
+}
+
+// Free the 2^order pages at v from kalloc_order(order).
+void
+kfree_order(char *v, int order)
+{
+  if(order == 0){
+    kfree(v);
+    return;
+  }
+  if(order < 0 || order >= NORDER || V2P(v) % (PGSIZE << order) ||
+     v < end || V2P(v) + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+
+  memset(v, 1, PGSIZE << order);
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  buddyfree(v, order);
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Take another reference to the page at v, which the
+// next kfree() of it will drop.
+void
+kdup(char *v)
+{
+  uint pn;
+
+  pn = V2P(v)/PGSIZE;
+  acquire(&reflock);
+  if(kref[pn] == 0xFFFF)
+    panic("kdup");
+  kref[pn]++;
+  release(&reflock);
+}
+
+// Return the number of references to the page at v.
+int
+krefs(char *v)
+{
+  return kref[V2P(v)/PGSIZE] + 1;
 }
 
+// Report the kalloc() and kfree() calls made on a CPU.
+void
+kstat(int cpu, uint *allocs, uint *frees)
+{
+  *allocs = kcache[cpu].allocs;
+  *frees = kcache[cpu].frees;
+}
+
+// Report how much memory is free and how fragmented it is.
+// The per-CPU cache counts are read without locking.
+void
+kmemstat(struct memstat *ms)
+{
+  int k;
+
+  ms->cached = 0;
+  for(k = 0; k < NCPU; k++)
+    ms->cached += kcache[k].nfree;
+  acquire(&kmem.lock);
+  ms->freepages = ms->cached;
+  ms->largest = -1;
+  for(k = 0; k < NORDER; k++){
+    ms->nfree[k] = kmem.nfree[k];
+    ms->fails[k] = kmem.fails[k];
+    ms->freepages += kmem.nfree[k] << k;
+    if(kmem.nfree[k])
+      ms->largest = k;
+  }
+  release(&kmem.lock);
+}
@@ -113,6 +113,31 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Send interrupt vector to the CPU with the given APIC ID.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
+// Stop or restart this CPU's timer interrupts.
+void
+lapictimer(int on)
+{
+  if(!lapic)
+    return;
+  if(on){
+    lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
+    lapicw(TICR, 10000000);
+  } else
+    lapicw(TIMER, MASKED | PERIODIC | (T_IRQ0 + IRQ_TIMER));
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
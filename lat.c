@@ -0,0 +1,65 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "sysstat.h"
+#include "sched.h"
+
+static char *names[NSCHED] = {
+[SCHED_DEFAULT] "default",
+[SCHED_FCFS]    "fcfs",
+[SCHED_PBS]     "pbs",
+[SCHED_MLFQ]    "mlfq",
+[SCHED_CFS]     "cfs",
+[SCHED_STRIDE]  "stride",
+};
+
+// Print the non-empty buckets of a run and a wake histogram.
+static void
+hist(char *title, uint *run, uint *wake)
+{
+  int b;
+
+  printf(1, "%s\nus\trun\twake\n", title);
+  for(b = 0; b < NLAT; b++){
+    if(run[b] == 0 && wake[b] == 0)
+      continue;
+    if(b == 0)
+      printf(1, "<1");
+    else if(b == NLAT-1)
+      printf(1, ">=%d", 1 << (b-1));
+    else
+      printf(1, "%d-%d", 1 << (b-1), (1 << b) - 1);
+    printf(1, "\t%d\t%d\n", run[b], wake[b]);
+  }
+}
+
+// Print the scheduling latency histograms of a process,
+// and the system-wide ones of a policy.
+int
+main(int argc, char *argv[])
+{
+  struct latstat ls;
+  int pid, pol;
+
+  pid = argc > 1 ? atoi(argv[1]) : 0;
+  pol = -1;
+  if(argc > 2){
+    for(pol = 0; pol < NSCHED; pol++)
+      if(strcmp(argv[2], names[pol]) == 0)
+        break;
+    if(pol == NSCHED){
+      printf(2, "usage: lat [pid [default|fcfs|pbs|mlfq|cfs|stride]]\n");
+      exit();
+    }
+  }
+  if(latstat(pid, pol, &ls) < 0){
+    printf(2, "lat: no process %d\n", pid);
+    exit();
+  }
+  printf(1, "pid %d: %d runs, wait %d us\n", ls.ps.pid, ls.ps.num_run,
+         ls.ps.wtime);
+  hist("process", ls.run, ls.wake);
+  hist(names[ls.policy], ls.sysrun, ls.syswake);
+  exit();
+}
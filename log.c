@@ -157,8 +157,8 @@ end_op(void)
   } else {
     // begin_op() may be waiting for log space,
     // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
+    // the amount of reserved space, by one op's worth.
+    wakeone(&log);
   }
   release(&log.lock);
 
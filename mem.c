@@ -0,0 +1,37 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "sysstat.h"
+
+// Print free memory by block size.  For each size, the
+// unusable column is the percentage of free pages that lie
+// in smaller blocks and so cannot serve an allocation of
+// that size.  Then print each slab cache.
+int
+main(int argc, char *argv[])
+{
+  struct memstat ms;
+  struct slabstat ss;
+  uint small;
+  int k;
+
+  if(memstat(&ms) < 0){
+    printf(2, "mem: memstat failed\n");
+    exit();
+  }
+  printf(1, "%d pages free, %d in per-CPU caches, largest block 2^%d\n",
+         ms.freepages, ms.cached, ms.largest);
+  printf(1, "pages\tfree\tunusable%%\tfailed\n");
+  small = ms.cached;
+  for(k = 0; k < NORDER; k++){
+    printf(1, "%d\t%d\t%d\t\t%d\n", 1 << k, ms.nfree[k],
+           ms.freepages ? small * 100 / ms.freepages : 0, ms.fails[k]);
+    small += ms.nfree[k] << k;
+  }
+  printf(1, "cache\tsize\tslabs\tlive\tcached\n");
+  for(k = 0; slabstat(k, &ss) == 0; k++)
+    printf(1, "%s\t%d\t%d\t%d\t%d\n", ss.name, ss.size, ss.slabs,
+           ss.live, ss.cached);
+  exit();
+}
@@ -1,14 +1,24 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC       512  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          2  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
+#define NQUEUE        5  // number of MLFQ levels
+#define AGETICKS    100  // ticks a queued MLFQ process waits before promotion
+#define MIGRATECOST   1  // ticks a process stays cache-hot on its last CPU
+#define NTICKETS    100  // default tickets of a process (STRIDE)
+#define MAXTICKETS 10000  // maximum tickets of a process
+#define HZ          100  // nominal timer ticks per second
+#define NWAITQ       64  // wait channel hash buckets, a power of two
+#define NTRACE     1024  // scheduler trace events kept per CPU, a power of two
+#define RTLIMIT      90  // percent of a CPU real-time processes may reserve
+#define NORDER       11  // buddy allocator block sizes, 2^0 to 2^10 pages
+#define NPIDHASH    256  // pid hash buckets, a power of two
+#define NLAT         20  // scheduling latency histogram buckets, log2 microseconds
 
@@ -0,0 +1,48 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NROUND 10000
+
+// Bounce a byte between two processes over a pair of pipes
+// and report how long the round trips took, or with -y,
+// have each side also yield_to() the other after writing.
+int
+main(int argc, char *argv[])
+{
+  int ping[2], pong[2], pid, peer, i, y, start;
+  char c;
+
+  y = argc > 1 && strcmp(argv[1], "-y") == 0;
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(2, "pingpong: pipe failed\n");
+    exit();
+  }
+  peer = getpid();
+  if((pid = fork()) < 0){
+    printf(2, "pingpong: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    for(i = 0; i < NROUND; i++){
+      if(read(ping[0], &c, 1) != 1)
+        break;
+      write(pong[1], &c, 1);
+      if(y)
+        yield_to(peer);
+    }
+    exit();
+  }
+
+  start = uptime();
+  for(i = 0; i < NROUND; i++){
+    write(ping[1], "x", 1);
+    if(y)
+      yield_to(pid);
+    if(read(pong[0], &c, 1) != 1)
+      break;
+  }
+  printf(1, "pingpong: %d round trips in %d ticks\n", i, uptime() - start);
+  wait();
+  exit();
+}
@@ -6,37 +6,79 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "sleeplock.h"
+#include "sched.h"
+#include "runq.h"
+#include "trace.h"
+#include "sysstat.h"
+
+// The process table.  Slots are carved out of pages (chunks)
+// taken from kalloc as more processes are needed, up to NPROC.
+// Each chunk keeps its own list of slots not in use, and new
+// processes take the lowest chunk with room, so that chunks
+// above the live processes empty out; a chunk is given back
+// as soon as its last slot is freed.  Slots in use are indexed
+// by pid, and each process also heads a list of its children.
+// All of it is guarded by ptable.lock.
+#define NPERCHUNK (PGSIZE / sizeof(struct proc))
+#define NCHUNK ((NPROC + NPERCHUNK - 1) / NPERCHUNK)
 
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc *chunk[NCHUNK];      // Pages of slots, or 0
+  struct proc *free[NCHUNK];       // Each chunk's UNUSED slots
+  int nused[NCHUNK];               // Slots in use in each chunk
+  struct proc *pidhash[NPIDHASH];  // Chains linked through pidnext
 } ptable;
 
+// Sleeping processes, in queues hashed by wait channel,
+// so a wakeup only looks at processes that may be waiting
+// on its channel.  A process is on the queue for p->chan
+// exactly while it is SLEEPING, and both change only with
+// that queue's lock held.
+//
+// Lock order: ptable.lock or the caller's sleep lock,
+// then a wait queue lock, then a run queue lock.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;           // Longest sleeper
+  struct proc *tail;
+};
+
+static struct waitq waitqs[NWAITQ];
+
+// The process table snapshot for getprocs(), taken under
+// ptable.lock and copied out to the caller after it has
+// been released.
+static struct {
+  struct sleeplock lock;
+  struct pinfo info[NPROC];
+} snap;
+
 static struct proc *initproc;
-#ifdef MLFQ
-struct proc* q1[64];
-struct proc* q2[64];
-struct proc* q3[64];
-struct proc* q4[64];
-struct proc* q5[64];
-int c1=0;
-int c2=0;
-int c3=0;
-int c4=0;
-int c5=0;
-int clicks_per_queue[5]={1, 2, 4, 8, 16};
-#endif
 
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
-static void wakeup1(void *chan);
+static void fillstat(struct proc*, struct procstat*);
+static void killproc(struct proc*);
+static void dispatch(struct cpu*, struct proc*);
+static void handoff(struct proc*);
+static void sleepwq(struct waitq*, void*);
 
 void
 pinit(void)
 {
+  int i;
+
   initlock(&ptable.lock, "ptable");
+  if(sizeof(struct proc) > PGSIZE)
+    panic("pinit: proc");
+  initsleeplock(&snap.lock, "snap");
+  for(i = 0; i < NWAITQ; i++)
+    initlock(&waitqs[i].lock, "waitq");
+  rqinit();
 }
 
 // Must be called with interrupts disabled
@@ -78,50 +120,175 @@ myproc(void) {
   return p;
 }
 
+static struct proc**
+pidchain(int pid)
+{
+  return &ptable.pidhash[pid & (NPIDHASH-1)];
+}
+
+// Return the process with the given pid, or 0.
+// Caller must hold ptable.lock.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  for(p = *pidchain(pid); p; p = p->pidnext)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+// Number of slots in chunk k; the last may be short.
+static int
+chunkslots(int k)
+{
+  return k < NCHUNK-1 ? NPERCHUNK : NPROC - (NCHUNK-1)*NPERCHUNK;
+}
+
+// Return the chunk holding p.
+static int
+chunkof(struct proc *p)
+{
+  int k;
+
+  for(k = 0; k < NCHUNK; k++)
+    if(ptable.chunk[k] && p >= ptable.chunk[k] &&
+       p < ptable.chunk[k] + chunkslots(k))
+      return k;
+  panic("chunkof");
+}
+
+// Return the slot after p, or the first if p is 0,
+// walking every chunk in use.  Return 0 after the last.
+// Caller must hold ptable.lock.
+static struct proc*
+nextslot(struct proc *p)
+{
+  int k;
+
+  k = 0;
+  if(p){
+    k = chunkof(p);
+    if(++p < ptable.chunk[k] + chunkslots(k))
+      return p;
+    k++;
+  }
+  for(; k < NCHUNK; k++)
+    if(ptable.chunk[k])
+      return ptable.chunk[k];
+  return 0;
+}
+
+// Take p out of the pid index and put its slot back on its
+// chunk's free list, giving the chunk back to kalloc if no
+// slot in it is used any more.  Caller must hold ptable.lock.
+static void
+freeproc(struct proc *p)
+{
+  struct proc **pp;
+  int k;
+
+  for(pp = pidchain(p->pid); *pp != p; pp = &(*pp)->pidnext)
+    ;
+  *pp = p->pidnext;
+  p->pid = 0;
+  p->parent = 0;
+  p->children = 0;
+  p->name[0] = 0;
+  p->killed = 0;
+  p->state = UNUSED;
+  k = chunkof(p);
+  p->pidnext = ptable.free[k];
+  ptable.free[k] = p;
+  if(--ptable.nused[k] == 0){
+    kfree((char*)ptable.chunk[k]);
+    ptable.chunk[k] = 0;
+    ptable.free[k] = 0;
+  }
+}
+
+// Fill empty chunk k with a page of new slots.  Return -1
+// when out of memory.  Caller must hold ptable.lock.
+static int
+growptable(int k)
+{
+  struct proc *p;
+  char *pg;
+
+  if((pg = kalloc()) == 0)
+    return -1;
+  memset(pg, 0, PGSIZE);
+  ptable.chunk[k] = (struct proc*)pg;
+  for(p = ptable.chunk[k] + chunkslots(k) - 1; p >= ptable.chunk[k]; p--){
+    p->pidnext = ptable.free[k];
+    ptable.free[k] = p;
+  }
+  return 0;
+}
+
+// Return the lowest chunk with a free slot, filling an
+// empty one if need be, or -1 at the NPROC ceiling or
+// when out of memory.  Caller must hold ptable.lock.
+static int
+freechunk(void)
+{
+  int k, empty;
+
+  empty = -1;
+  for(k = 0; k < NCHUNK; k++){
+    if(ptable.chunk[k] == 0){
+      if(empty < 0)
+        empty = k;
+    } else if(ptable.free[k])
+      return k;
+  }
+  if(empty < 0 || growptable(empty) < 0)
+    return -1;
+  return empty;
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
+// Take a proc off the free list, growing the table if need be.
 // If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
 static struct proc*
 allocproc(void)
 {
-  struct proc *p;
+  struct proc *p, **pp;
   char *sp;
+  int k;
 
   acquire(&ptable.lock);
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  #ifdef MLFQ 
-  p->priority = 1;
-  c1++;
-  q1[c1-1] = p;
-  #endif 
-  #ifdef PBS
-  p->priority = 60;
-  #endif
-  release(&ptable.lock);
-  return 0;
-
-found:
+  if((k = freechunk()) < 0){
+    release(&ptable.lock);
+    return 0;
+  }
+  p = ptable.free[k];
+  ptable.free[k] = p->pidnext;
+  ptable.nused[k]++;
   p->state = EMBRYO;
   p->pid = nextpid++;
-  #ifdef MLFQ
-  p->priority = 1;
-  c1++;
-  q1[c1-1] = p;
-  #endif
-  #ifdef PBS
+  pp = pidchain(p->pid);
+  p->pidnext = *pp;
+  *pp = p;
   p->priority = 60;
-  #endif
+  p->level = 1;
+  p->children = 0;
+  p->leader = p;
+  p->threads = 0;
+  p->held = 0;
+  p->inhpri = p->inhlevel = NOINHERIT;
+  p->inversions = 0;
+  p->invtsc = 0;
   release(&ptable.lock);
 
   // Allocate kernel stack.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -144,10 +311,56 @@ found:
   p->etime = 0;
   p->rtime = 0;
   p->iotime=0;
+  p->tsc = rdtsc();
+  p->utsc = p->stsc = p->wtsc = 0;
+  p->lastcpu = -1;
+  p->vruntime = 0;
+  p->tickets = NTICKETS;
+  p->pass = 0;
+  p->rtperiod = 0;
+  p->timeridx = -1;
+  p->migrations = 0;
+  p->steals = 0;
+  p->woken = 0;
+  memset(p->lat, 0, sizeof p->lat);
+  memset(p->wlat, 0, sizeof p->wlat);
 
   return p;
 }
 
+static struct waitq*
+waitq(void *chan)
+{
+  return &waitqs[((uint)chan * 2654435761U) >> 24 & (NWAITQ-1)];
+}
+
+// Append p to wq, which must be locked.
+static void
+wqinsert(struct waitq *wq, struct proc *p)
+{
+  p->wqnext = 0;
+  p->wqprev = wq->tail;
+  if(wq->tail)
+    wq->tail->wqnext = p;
+  else
+    wq->head = p;
+  wq->tail = p;
+}
+
+static void
+wqremove(struct waitq *wq, struct proc *p)
+{
+  if(p->wqprev)
+    p->wqprev->wqnext = p->wqnext;
+  else
+    wq->head = p->wqnext;
+  if(p->wqnext)
+    p->wqnext->wqprev = p->wqprev;
+  else
+    wq->tail = p->wqprev;
+  p->wqnext = p->wqprev = 0;
+}
+
 //PAGEBREAK: 32
 // Set up first user process.
 void
@@ -173,35 +386,70 @@ userinit(void)
   p->tf->eip = 0;  // beginning of initcode.S
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  if((p->fdt = fdtalloc(0)) == 0)
+    panic("userinit: out of memory?");
 
-  // this assignment to p->state lets other cores
-  // run this process. the acquire forces the above
-  // writes to be visible, and the lock is also needed
-  // because the assignment might not be atomic.
+  // queueing p lets this core run it. the acquire
+  // forces the above writes to be visible before
+  // p->state changes.
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  p->cpu = cpuid();
+  rqready(p);
   release(&ptable.lock);
 }
 
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
+// Threads sharing the memory see the new size; ptable.lock
+// keeps two of them from growing it at once, and the leader's
+// shrinking flag keeps them waiting while one frees memory.
+// Growing only reserves the address space: uvmfault() maps
+// each page when it is first touched.  It still fails when
+// asking for more pages than are free, so that a program
+// allocating until sbrk() fails stops before memory runs out.
 int
 growproc(int n)
 {
-  uint sz;
-  struct proc *curproc = myproc();
+  uint sz, oldsz;
+  struct memstat ms;
+  struct proc *p, *leader, *curproc = myproc();
 
-  sz = curproc->sz;
+  acquire(&ptable.lock);
+  leader = curproc->leader;
+  while(leader->shrinking)
+    sleep(&leader->shrinking, &ptable.lock);
+  oldsz = sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    kmemstat(&ms);
+    if(sz + n >= KERNBASE || sz + n < sz ||
+       (PGROUNDUP(sz + n) - PGROUNDUP(sz)) / PGSIZE > ms.freepages){
+      release(&ptable.lock);
       return -1;
+    }
+    sz += n;
   } else if(n < 0){
-    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if(sz + n > sz){
+      release(&ptable.lock);
       return -1;
+    }
+    sz += n;
+    leader->shrinking = 1;
+  }
+  leader->sz = sz;
+  for(p = leader->threads; p; p = p->tnext)
+    p->sz = sz;
+  release(&ptable.lock);
+
+  if(n < 0){
+    // Threads may be using the pages on other CPUs;
+    // unmap them everywhere before freeing them.
+    shrinkuvm(curproc->pgdir, oldsz, sz);
+    acquire(&ptable.lock);
+    leader->shrinking = 0;
+    release(&ptable.lock);
+    wakeup(&leader->shrinking);
   }
-  curproc->sz = sz;
   switchuvm(curproc);
   return 0;
 }
@@ -212,7 +460,7 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int pid;
   struct proc *np;
   struct proc *curproc = myproc();
 
@@ -225,7 +473,9 @@ fork(void)
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
     kfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
@@ -235,11 +485,74 @@ fork(void)
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
   np->priority = curproc->priority;
+  np->vruntime = curproc->vruntime;
+  np->tickets = curproc->tickets;
+  np->pass = curproc->pass;
+
+  if((np->fdt = fdtalloc(curproc->fdt)) == 0){
+    freevm(np->pgdir);
+    np->pgdir = 0;
+    kfree(np->kstack);
+    np->kstack = 0;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
+    return -1;
+  }
+
+  safestrcpy(np->name, curproc->name, sizeof(curproc->name));
+
+  pid = np->pid;
+
+  acquire(&ptable.lock);
+
+  np->sibling = curproc->children;
+  curproc->children = np;
+  np->cpu = rqplace();
+  rqready(np);
+
+  release(&ptable.lock);
+
+  return pid;
+}
+
+// Create a thread that shares the caller's memory,
+// open files and cwd.  It starts in fn(arg) on
+// the PGSIZE bytes of user stack at stack.  Return its pid.
+int
+clone(void (*fn)(void*), void *arg, void *stack)
+{
+  int pid;
+  uint sp, ustack[2];
+  struct proc *np, *leader;
+  struct proc *curproc = myproc();
+
+  if((np = allocproc()) == 0)
+    return -1;
 
-  for(i = 0; i < NOFILE; i++)
-    if(curproc->ofile[i])
-      np->ofile[i] = filedup(curproc->ofile[i]);
-  np->cwd = idup(curproc->cwd);
+  // fn returns to a bad address and faults;
+  // the thread library calls exit() instead.
+  ustack[0] = 0xffffffff;
+  ustack[1] = (uint)arg;
+  sp = (uint)stack + PGSIZE - sizeof(ustack);
+  if(copyout(curproc->pgdir, curproc->sz, sp, ustack, sizeof(ustack)) < 0){
+    kfree(np->kstack);
+    np->kstack = 0;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
+    return -1;
+  }
+  np->pgdir = curproc->pgdir;
+  np->ustack = stack;
+  *np->tf = *curproc->tf;
+  np->tf->eip = (uint)fn;
+  np->tf->esp = sp;
+  np->priority = curproc->priority;
+  np->vruntime = curproc->vruntime;
+  np->tickets = curproc->tickets;
+  np->pass = curproc->pass;
+  np->fdt = fdtshare(curproc->fdt);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
@@ -247,56 +560,119 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
+  leader = curproc->leader;
+  np->leader = leader;
+  np->tnext = leader->threads;
+  leader->threads = np;
+  np->sz = curproc->sz;
+  np->parent = curproc;
+  np->sibling = curproc->children;
+  curproc->children = np;
+  np->cpu = rqplace();
+  rqready(np);
 
   release(&ptable.lock);
 
   return pid;
 }
 
+// Free the rest of p, a ZOMBIE already taken off its
+// parent's list of children.  A thread's memory belongs
+// to its leader.  Caller must hold ptable.lock.
+static void
+reap(struct proc *p)
+{
+  struct proc **pp;
+
+  rqdrain(p);
+  kfree(p->kstack);
+  p->kstack = 0;
+  if(p->leader == p)
+    freevm(p->pgdir);
+  else {
+    for(pp = &p->leader->threads; *pp != p; pp = &(*pp)->tnext)
+      ;
+    *pp = p->tnext;
+  }
+  freeproc(p);
+}
+
+// Kill the other threads of curproc, which leads them, and
+// reap them, since its parent will free their memory.
+// Caller must hold ptable.lock.
+static void
+endthreads(struct proc *curproc)
+{
+  struct proc *p, *next, **pp;
+
+  while(curproc->threads){
+    for(p = curproc->threads; p; p = next){
+      next = p->tnext;
+      if(p->state != ZOMBIE){
+        killproc(p);
+        continue;
+      }
+      for(pp = &p->parent->children; *pp != p; pp = &(*pp)->sibling)
+        ;
+      *pp = p->sibling;
+      reap(p);
+    }
+    if(curproc->threads)
+      sleep(&curproc->threads, &ptable.lock);
+  }
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
+// A thread exits alone, and its parent join()s it; the
+// leader of an address space takes its threads with it.
 void
 exit(void)
 {
   struct proc *curproc = myproc();
-  struct proc *p;
-  int fd;
+  struct proc *p, *np;
 
   if(curproc == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(fd = 0; fd < NOFILE; fd++){
-    if(curproc->ofile[fd]){
-      fileclose(curproc->ofile[fd]);
-      curproc->ofile[fd] = 0;
-    }
-  }
+  acquire(&ptable.lock);
+  endthreads(curproc);
+  release(&ptable.lock);
 
-  begin_op();
-  iput(curproc->cwd);
-  end_op();
-  curproc->cwd = 0;
+  // Give back its real-time reservation.
+  rqsetrt(curproc, 0, 0, 0);
 
-  acquire(&ptable.lock);
+  // Close all open files, unless threads still use them.
+  fdtput(curproc->fdt);
+  curproc->fdt = 0;
 
-  // Parent might be sleeping in wait().
-  wakeup1(curproc->parent);
+  acquire(&ptable.lock);
 
-  // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
-      p->parent = initproc;
-      if(p->state == ZOMBIE)
-        wakeup1(initproc);
-    }
+  // Parent might be sleeping in wait(), and
+  // the leader waiting for its threads to end.
+  wakeup(curproc->parent);
+  if(curproc->leader != curproc)
+    wakeup(&curproc->leader->threads);
+
+  // Pass abandoned threads to their leader
+  // and abandoned processes to init.
+  while((p = curproc->children) != 0){
+    curproc->children = p->sibling;
+    np = p->leader != p ? p->leader : initproc;
+    p->parent = np;
+    p->sibling = np->children;
+    np->children = p;
+    if(p->state == ZOMBIE)
+      wakeup(np);
   }
 
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
   curproc->etime = ticks; // TODO Might need to protect the read of ticks with a lock
+  trace(TR_EXIT, curproc, 0);
+  rqlock();
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
@@ -306,29 +682,37 @@ exit(void)
 int
 wait(void)
 {
-  struct proc *p;
+  return waitx(0, 0, 0);
+}
+
+// Wait like wait(), and report the child's wait and run
+// times in ticks and its getpinfo statistics.
+int
+waitx(int *wtime, int *rtime, struct procstat *st)
+{
+  struct proc *p, **pp;
   int havekids, pid;
   struct proc *curproc = myproc();
-  
+
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through the children looking for exited ones.
     havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
+    for(pp = &curproc->children; (p = *pp) != 0; pp = &p->sibling){
+      if(p->leader != p)
+        continue;  // a thread, for join()
       havekids = 1;
       if(p->state == ZOMBIE){
         // Found one.
+        *pp = p->sibling;
+        if(wtime)
+          *wtime= p->etime - p->ctime - p->rtime - p->iotime;
+        if(rtime)
+          *rtime=p->rtime;
+        if(st)
+          fillstat(p, st);
         pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        reap(p);
         release(&ptable.lock);
         return pid;
       }
@@ -340,71 +724,154 @@ wait(void)
       return -1;
     }
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
+    // Wait for children to exit.  (See wakeup call in exit.)
     sleep(curproc, &ptable.lock);  //DOC: wait-sleep
   }
 }
 
+// Wait for a thread this one created to exit and return
+// its pid, and the stack it was given in *stack.
+// Return -1 if it has no such threads.
 int
-waitx(int *wtime, int *rtime)
+join(void **stack)
 {
-  struct proc *p;
+  struct proc *p, **pp;
   int havekids, pid;
+  void *ustack;
   struct proc *curproc = myproc();
 
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
     havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
+    for(pp = &curproc->children; (p = *pp) != 0; pp = &p->sibling){
+      if(p->leader == p)
+        continue;  // a process, for wait()
       havekids = 1;
       if(p->state == ZOMBIE){
-        // Found one.
-        *wtime= p->etime - p->ctime - p->rtime - p->iotime;
-        *rtime=p->rtime;
+        *pp = p->sibling;
         pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        ustack = p->ustack;
+        reap(p);
         release(&ptable.lock);
+        *stack = ustack;
         return pid;
       }
     }
 
-    // No point waiting if we don't have any children.
     if(!havekids || curproc->killed){
       release(&ptable.lock);
       return -1;
     }
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock);  //DOC: wait-sleep
+    sleep(curproc, &ptable.lock);
   }
 }
 
-int getpinfo(struct procstat* curproc){
-  struct proc *p = myproc();
-  curproc->pid = p->pid;
-  curproc->current_queue = p->priority;
-  curproc->num_run = p->num_run;
+// Charge the TSC cycles since p->tsc to *acct
+// and start timing p's next state.
+uint64
+tsccharge(struct proc *p, uint64 *acct)
+{
+  uint64 now, n;
+
+  now = rdtsc();
+  n = now - p->tsc;
+  *acct += n;
+  p->tsc = now;
+  return n;
+}
+
+static void
+fillstat(struct proc *p, struct procstat *st)
+{
+  st->pid = p->pid;
+  st->current_queue = p->level;
+  st->num_run = p->num_run;
   for(int i = 0; i < 5; i++)
-    curproc->ticks[i]=p->cq[i];
-  curproc->runtime = p->rtime;
+    st->ticks[i]=p->cq[i];
+  st->runtime = p->rtime;
+  st->cpu = p->lastcpu;
+  st->migrations = p->migrations;
+  st->steals = p->steals;
+  st->utime = tscus(p->utsc);
+  st->stime = tscus(p->stsc);
+  st->wtime = tscus(p->wtsc);
+  st->inversions = p->inversions;
+  st->invtime = tscus(p->invtsc);
+}
+
+// Copy the latency histograms of process pid, or of the
+// caller if pid is 0, and the system-wide ones of policy
+// pol, or of the current policy if pol is -1.
+int
+latstat(int pid, int pol, struct latstat *ls)
+{
+  struct proc *p;
+  int found;
+
+  memset(ls, 0, sizeof(*ls));
+  if(pid == 0)
+    pid = myproc()->pid;
+  found = 0;
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0){
+    fillstat(p, &ls->ps);
+    memmove(ls->run, p->lat, sizeof ls->run);
+    memmove(ls->wake, p->wlat, sizeof ls->wake);
+    found = 1;
+  }
+  release(&ptable.lock);
+  if(!found)
+    return -1;
+  if(pol == -1)
+    pol = rqsetpolicy(-1);
+  if(pol < 0 || pol >= NSCHED)
+    return -1;
+  ls->policy = pol;
+  rqlatsum(pol, ls->sysrun, ls->syswake);
+  return 0;
+}
+
+int getpinfo(struct procstat* curproc){
+  fillstat(myproc(), curproc);
   return 25;
 }
 
+// Copy the scheduler counters of up to n CPUs to st.
+// Return the number of CPUs copied.
+int
+cpustat(struct cpustat *st, int n)
+{
+  struct runq *rq;
+  int i;
+
+  for(i = 0; i < n && i < ncpu; i++){
+    rq = cpus[i].rq;
+    acquire(&rq->lock);
+    st[i].cpu = i;
+    st[i].idlems = 0;
+    if(tscpertick >= 1000/HZ)
+      st[i].idlems = udiv64(cpus[i].idletsc, tscpertick / (1000/HZ));
+    st[i].halts = cpus[i].halts;
+    st[i].ipis = cpus[i].ipis;
+    st[i].steals = rq->steals;
+    st[i].migrations = rq->migrations;
+    kstat(i, &st[i].kallocs, &st[i].kfrees);
+#ifdef TICKLESS
+    st[i].tickless = i != 0;
+#else
+    st[i].tickless = 0;
+#endif
+    release(&rq->lock);
+  }
+  return i;
+}
+
 //PAGEBREAK: 42
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run
+//  - choose a process to run from this CPU's run queue
 //  - swtch to start running that process
 //  - eventually that process transfers control
 //      via swtch back to the scheduler.
@@ -413,518 +880,176 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  struct runq *rq = c->rq;
   c->proc = 0;
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    #ifdef DEFAULT
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
+    // An idle CPU takes work from the busiest one
+    // rather than spinning on an empty queue.
+    if(rq->n == 0)
+      rqsteal(rq);
 
+    // Take the next process from this CPU's run queue;
+    // the queue is kept in the order the policy wants.
+    acquire(&rq->lock);
+    if((p = rqpick(rq)) != 0){
       // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
+      // to release rq->lock and then reacquire it
       // before jumping back to us.
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
+      dispatch(c, p);
       swtch(&(c->scheduler), p->context);
       switchkvm();
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
+      // Processes are done running for now.  The last
+      // one has charged itself in sched() and found
+      // nothing else queued to switch to.
       c->proc = 0;
-    }
-    #else
-    #ifdef FCFS
-    struct proc *minP = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state == RUNNABLE){
-        if (minP!=0  && p->ctime < minP->ctime)
-          minP = p;
-        else if(minP == 0)
-          minP = p;
-      }
-    }
-    if (minP!=0){
-      p = minP;//the process with the smallest creation time
-      c->proc = p;
-      cprintf("state = %d ctime = %d pid = %d \t",p->state, p->ctime, p->pid);
-      switchuvm(p);
-      p->state = RUNNING;
-      swtch(&c->scheduler, p->context);
-      switchkvm();
-      cprintf("state after ending = %d\n", p->state);
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-    
-    #else
-    #ifdef PBS
-    struct proc *p1;
-    struct proc *highP =  0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
-      highP = p;
-      for(p1=ptable.proc; p1<&ptable.proc[NPROC];p1++){
-          if(p1->state != RUNNABLE)
-            continue;
-          if(highP->priority > p1->priority) // larger value, lower priority
-            highP = p1;
-      }
-      p = highP;
-      //cprintf("state = %d priority = %d pid = %d \t",p->state, p->priority, p->pid);
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
-      swtch(&(c->scheduler), p->context);
-      //cprintf("state after ending = %d\n", p->state);
-      switchkvm();
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-    #else
-    #ifdef MLFQ
-padhi:
-    for(int i = 0; i < c2; i++){
-      if(q2[i]->state==RUNNABLE && (ticks - (q2[i]->last_time))>100){
-  //        cprintf("%s-%d getting promoted\n",q2[i]->name, q2[i]->pid);
-          p = q2[i];
-          p->priority=1;
-          q2[i]=0;
-          for(int j = i; j<c2-1; j++)
-              q2[j]=q2[j+1];
-          
-          c2--;
-          c1++;
-          i--;
-          q1[c1-1]=p;
-          p->last_time=ticks;
-      }
-    }
-    for(int i = 0; i < c3; i++){
-      if(q3[i]->state==RUNNABLE && (ticks - (q3[i]->last_time))>100){
-  //        cprintf("%s-%d getting promoted\n",q3[i]->name, q3[i]->pid);
-          p = q3[i];
-          p->priority=2;
-          q3[i]=0;
-          for(int j = i; j<c3-1; j++)
-              q3[j]=q3[j+1];
-          c3--;
-          c2++;
-          i--;
-          q2[c2-1]=p;
-          p->last_time=ticks;
-      }
-    }
-    for(int i = 0; i < c4; i++){
-      if(q4[i]->state==RUNNABLE && (ticks - (q4[i]->last_time))>100){
- //         cprintf("%s-%d getting promoted\n",q4[i]->name, q4[i]->pid);
-          p = q4[i];
-          p->priority=3;
-          q4[i]=0;
-          for(int j = i; j<c4-1; j++)
-              q4[j]=q4[j+1];
-          c4--;
-          c3++;
-          i--;
-          q3[c3-1]=p;
-          p->last_time=ticks;
-      }
-    }
-    for(int i = 0; i < c5; i++){
-      if(q5[i]->state==RUNNABLE && (ticks - (q5[i]->last_time))>100){
-  //        cprintf("%s-%d getting promoted\n",q5[i]->name, q5[i]->pid);
-          p = q5[i];
-          p->priority=4;
-          q5[i]=0;
-          for(int j = i; j<c5-1; j++)
-              q5[j]=q5[j+1];
-          c5--;
-          c4++;
-          i--;
-          q4[c4-1]=p;
-          p->last_time=ticks;
-      }
-    }
-    if(c1){
-      //cprintf("xd\n");
-      for(int i = 0; i < c1; i++){
-        if(q1[i]->state != RUNNABLE)
-          continue;
-        //if(q1[i]){
-          p = q1[i];
-          //cprintf("from c0. id =%d name =%s\n",p->pid,p->name);
-				  cprintf("executing this at time  = %d. id=%d , name =%s , state =%d, priority=%d\n",ticks,p->pid, p->name,p->state,p->priority);
-				  c->proc=p;
-          switchuvm(p);
-//          cprintf("tatte daba dunga\n");
-          p->state = RUNNING;
-          p->last_time=ticks;
-				  swtch(&c->scheduler, p->context);
-//          cprintf("I will switch your mother\n");
-				  switchkvm();
-//          cprintf("proc exec\n");
-          //if(p->clicks==clicks_per_queue[0]){
-//            cprintf("yeeting %s\n", p->name);
-//            release(&ptable.lock);
-//            yield();
-//            acquire(&ptable.lock);
-          /*  c2++;
-            p->priority++;
-            q2[c2-1]=p;
-            q1[i]=0;
-            for(int j = i; j < c1; j++){
-             q1[j] = q1[j+1];
-            }
-            c1--;*/
-          //}
-          c->proc = 0;
-          goto padhi;
-    //    }
-      }
-    }
-
-    if(c2){
-      for(int i = 0; i < c2; i++){
-        if(q2[i]->state != RUNNABLE)
-          continue;
-       // if(q2[i]){
-          p = q2[i];
-          //cprintf("from c0. id =%d name =%s\n",p->pid,p->name);
-				  cprintf("executing this  . id=%d , name =%s , state =%d, priority=%d\n",p->pid, p->name,p->state, p->priority);
-				  c->proc = p;
-          switchuvm(p);
-				  p->state = RUNNING;
-          p->last_time=ticks;
-//          cprintf("ttttttttttttttttt\n");
-				  swtch(&c->scheduler, p->context);
-//          cprintf("I will switch you\n");
-				  switchkvm();
-//          cprintf("proc exec\n");
-   //       if(p==clicks_per_queue[1]){
-//            release(&ptable.lock);
-//            yield();
-//            acquire(&ptable.lock);
-          /*  c3++;
-            p->priority++;
-            q2[c3-1]=p;
-            q2[i]=0;
-            for(int j = i; j < c2; j++){
-              q2[j] = q2[j+1];
-            } 
-            c2--;*/
-      //    }
-          c->proc = 0;
-          goto padhi;
-        //}
-      }
-    }
-
-    if(c3){
-      for(int i = 0; i < c3; i++){
-        if(q3[i]->state != RUNNABLE)
-          continue;
-        //if(q3[i]){
-          p = q3[i];
-          //cprintf("from c0. id =%d name =%s\n",p->pid,p->name);
-				  cprintf("executing this  . id=%d , name =%s , state =%d, priority=%d\n",p->pid, p->name,p->state,p->priority);
-				  c->proc = p;
-          switchuvm(p);
-//          cprintf("ttttttttttttttttttttt\n");
-				  p->state = RUNNING;
-          p->last_time=ticks;
-				  swtch(&c->scheduler, p->context);
-//          cprintf("I will switch you\n");
-				  switchkvm();
-//          cprintf("proc exec\n");
-        //  if(p->clicks==clicks_per_queue[2]){
-//            release(&ptable.lock);
-//            yield();
-//            acquire(&ptable.lock);
-           /*  c4++;
-            p->priority++;
-            q4[c4-1]=p;
-            q3[i]=0;
-            for(int j = i; j < c3; j++){
-              q3[j] = q3[j+1];
-            }
-            c3--;*/
-  //        }
-          c->proc = 0;
-          goto padhi;
-        //}
-      }
-    }
-
-    if(c4){
-      for(int i = 0; i < c4; i++){
-        if(q4[i]->state != RUNNABLE)
-          continue;
-        //if(q4[i]){
-          p = q4[i];
-          //cprintf("from c0. id =%d name =%s\n",p->pid,p->name);
-				  cprintf("executing this  . id=%d , name =%s , state =%d, priority=%d\n",p->pid, p->name,p->state, p->priority);
-				  c->proc = p;
-          switchuvm(p);
-				  p->state = RUNNING;
-          p->last_time=ticks;
-				  swtch(&c->scheduler, p->context);
-				  switchkvm();
-    //      if(p->clicks==clicks_per_queue[3]){
-//            release(&ptable.lock);
-//            yield();
-//            acquire(&ptable.lock);
-          /*    c5++;
-            p->priority++;
-            q5[c5-1]=p;
-            q4[i]=0;
-            for(int j = i; j < c4; j++){
-              q4[j] = q4[j+1];
-            }
-            c4--;*/
-      //    }
-          c->proc = 0;
-          goto padhi;
-        //}
-      }
-    }
-
-    if(c5){
-      for(int i = 0; i < c5; i++){
-        if(q5[i]->state != RUNNABLE)
-          continue;
-        //if(q5[i]){
-          p = q5[i];
-          //cprintf("from c0. id =%d name =%s\n",p->pid,p->name);
-				  cprintf("executing this  . id=%d , name =%s , state =%d, priority=%d\n",p->pid, p->name,p->state,p->priority);
-				  c->proc = p;
-          switchuvm(p);
-				  p->state = RUNNING;
-          p->last_time=ticks;
-				  swtch(&c->scheduler, p->context);
-				  switchkvm();
-        //  if(p->clicks==clicks_per_queue[4]){
-//            release(&ptable.lock);
-//            yield();
-//            acquire(&ptable.lock);
-           /*   q5[i]=0;
-            for(int j = i; j < c5; j++){
-              q5[j] = q5[j+1];
-            }
-            c5--;
-            q5[c5-1]=p;*/
-          
-         // c->proc = 0;
-          goto padhi;
-        //}
-      }
-    }
+      c->pgdir = 0;
+    } else
+      rqidle(rq);
+    release(&rq->lock);
+  }
+}
 
-    #endif
-    #endif
-    #endif
-    #endif
+// Make p, just taken off this CPU's run queue,
+// the process running on c.  The run queue is locked.
+static void
+dispatch(struct cpu *c, struct proc *p)
+{
+  struct runq *rq = c->rq;
 
-    release(&ptable.lock);
+  trace(TR_DISPATCH, p, p->priority);
+  if(p->lastcpu >= 0 && p->lastcpu != rq->cpu){
+    p->migrations++;
+    rq->migrations++;
   }
+  p->lastcpu = rq->cpu;
+  c->proc = p;
+  switchuvm(p);
+  p->state = RUNNING;
+  rq->active = ticks;
+  rqlatency(rq, p, tsccharge(p, &p->wtsc));
+  rq->activetsc = p->tsc;
+}
+
+// Enter scheduler.  Must hold only this CPU's run queue
+// lock and have changed proc->state.
+void
+sched(void)
+{
+  handoff(0);
 }
 
-// Enter scheduler.  Must hold only ptable.lock
-// and have changed proc->state. Saves and restores
-// intena because intena is a property of this
+// Stop running the current process and switch straight to
+// np, which the caller has taken off this CPU's run queue,
+// or if np is 0 to the next process queued on this CPU.
+// Only if there is none does it go through the scheduler,
+// which may find work elsewhere, so a switch usually costs
+// one swtch rather than two.  Must hold only this CPU's
+// run queue lock and have changed proc->state.  Saves and
+// restores intena because intena is a property of this
 // kernel thread, not this CPU. It should
 // be proc->intena and proc->ncli, but that would
 // break in the few places where a lock is held but
 // there's no process.
-void
-sched(void)
+static void
+handoff(struct proc *np)
 {
   int intena;
+  struct cpu *c = mycpu();
+  struct runq *rq = c->rq;
   struct proc *p = myproc();
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
-  if(mycpu()->ncli != 1)
+  if(!holding(&rq->lock))
+    panic("sched rq lock");
+  if(c->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
     panic("sched running");
   if(readeflags()&FL_IF)
     panic("sched interruptible");
-  intena = mycpu()->intena;
-  swtch(&p->context, mycpu()->scheduler);
+
+  tsccharge(p, &p->stsc);
+  rqcharge(p, ticks - rq->active, p->tsc - rq->activetsc);
+  p->lastrun = rq->active = ticks;
+  rq->activetsc = p->tsc;
+
+  // A process that yielded goes back on the queue
+  // only now, with its run charged to it.
+  if(p->state == RUNNABLE)
+    rqenqueue(rq, p);
+
+  if(np == 0 && (np = rqpick(rq)) == 0){
+    c->proc = 0;
+    intena = c->intena;
+    swtch(&p->context, c->scheduler);
+    mycpu()->intena = intena;
+    return;
+  }
+  dispatch(c, np);
+  if(np == p)
+    return;
+  intena = c->intena;
+  swtch(&p->context, np->context);
   mycpu()->intena = intena;
 }
 
 // Give up the CPU for one scheduling round.
+// sched() puts the process back on its queue.
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
-  myproc()->num_run++;
-#ifdef MLFQ
-//  cprintf("about to yeet %s\n",myproc()->name);
-  if(myproc()->priority==1){
-  if(myproc()->cq[0]>=clicks_per_queue[myproc()->priority-1]){
-    c2++;
-    myproc()->priority++;
-    q2[c2-1]=myproc();
-    int i=0;
-    for(int a = 0; a < c1; a++){
-      if(q1[a]->pid==myproc()->pid)
-          i = a;
-    }
-    q1[i]=0;
-    for(int j = i; j < c1-1; j++){
-     q1[j] = q1[j+1];
-    }
-    c1--;
-  }
-  else{
-    myproc()->cq[myproc()->priority-1]++;
-/*    int i = 0;
-    for(int a = 0; a < c1-1; a++){
-      if(q1[a]->pid==myproc()->pid)
-          i=a;
-    }
-    q1[i]=0;
-    for(int j = i; j<c1-1; j++){
-      q1[j]=q1[j-1];
-    }
-    q1[c1-1]=myproc();*/
-  }
-  }
+  struct proc *p;
 
-  if(myproc()->priority==2){
-  if(myproc()->cq[1]>=clicks_per_queue[myproc()->priority-1]){
-    c3++;
-    myproc()->priority++;
-    q3[c3-1]=myproc();
-    int i=0;
-    for(int a = 0; a < c2; a++){
-      if(q2[a]->pid==myproc()->pid)
-          i = a;
-    }
-    q2[i]=0;
-    for(int j = i; j < c2-1; j++){
-     q2[j] = q2[j+1];
-    }
-    c2--;
-  }
-  else{
-    myproc()->cq[myproc()->priority-1]++;
-/*    int i = 0;
-    for(int a = 0; a < c2-1; a++){
-      if(q2[a]->pid==myproc()->pid)
-          i=a;
-    }
-    q2[i]=0;
-    for(int j = i; j<c2-1; j++){
-      q2[j]=q2[j-1];
-    }
-    q2[c2-1]=myproc();*/
-  }
-  }
+  rqlock();  //DOC: yieldlock
+  p = myproc();
+  p->state = RUNNABLE;
+  p->num_run++;
+  trace(TR_PREEMPT, p, 0);
+  rqyield(p);
+  sched();
+  release(&mycpu()->rq->lock);
+}
 
-  if(myproc()->priority==3){
-  if(myproc()->cq[2]>=clicks_per_queue[myproc()->priority-1]){
-    c4++;
-    myproc()->priority++;
-    q4[c4-1]=myproc();
-    int i=0;
-    for(int a = 0; a < c3; a++){
-      if(q3[a]->pid==myproc()->pid)
-          i = a;
-    }
-    q3[i]=0;
-    for(int j = i; j < c3-1; j++){
-     q3[j] = q3[j+1];
-    }
-    c3--;
-  }
-  else{
-    myproc()->cq[myproc()->priority-1]++;
-/*    int i = 0;
-    for(int a = 0; a < c3-1; a++){
-      if(q3[a]->pid==myproc()->pid)
-          i=a;
-    }
-    q3[i]=0;
-    for(int j = i; j<c3-1; j++){
-      q3[j]=q3[j-1];
-    }
-    q3[c3-1]=myproc();*/
-  }
-  }
+// Give the rest of this time slice to process pid,
+// running it now.  Return -1, without yielding, if it
+// is not waiting for a CPU.
+int
+yieldto(int pid)
+{
+  struct proc *np, *p = myproc();
 
-  if(myproc()->priority==4){
-  if(myproc()->cq[3]>=clicks_per_queue[myproc()->priority-1]){
-    c5++;
-    myproc()->priority++;
-    q5[c5-1]=myproc();
-    int i=0;
-    for(int a = 0; a < c4; a++){
-      if(q4[a]->pid==myproc()->pid)
-          i = a;
-    }
-    q4[i]=0;
-    for(int j = i; j < c4-1; j++){
-     q4[j] = q4[j+1];
-    }
-    c4--;
-  }
-  else{
-    myproc()->cq[myproc()->priority-1]++;
-/*    int i = 0;
-    for(int a = 0; a < c4-1; a++){
-      if(q4[a]->pid==myproc()->pid)
-          i=a;
-    }
-    q4[i]=0;
-    for(int j = i; j<c4-1; j++){
-      q4[j]=q4[j-1];
-    }
-    q4[c4-1]=myproc();*/
-  }
+  acquire(&ptable.lock);
+  if((np = findproc(pid)) == 0 || np == p){
+    release(&ptable.lock);
+    return -1;
   }
-
-  else if(myproc()->priority == 5){
-    if(myproc()->cq[4]<=clicks_per_queue[myproc()->priority-1])
-        myproc()->cq[myproc()->priority-1]++;
-    else{
-    int i=0;
-    for(int a = 0; a < c5; a++){
-      if(q5[a]->pid == myproc()->pid)
-        i = a;
-    }
-    q5[i]=0;
-    for(int j = i; j < c5-1; j++){
-      q5[j] = q5[j+1];
-    }
-    q5[c5-1] = myproc();
-    }
+  if(!rqtake(np)){
+    release(&mycpu()->rq->lock);
+    release(&ptable.lock);
+    return -1;
   }
-#endif
-  sched();
   release(&ptable.lock);
+  p->state = RUNNABLE;
+  p->num_run++;
+  trace(TR_PREEMPT, p, 0);
+  rqyield(p);
+  handoff(np);
+  release(&mycpu()->rq->lock);
+  return 0;
 }
 
-
 // A fork child's very first scheduling by scheduler()
 // will swtch here.  "Return" to user space.
 void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding this CPU's run queue lock from scheduler()
+  // or from the process that handed the CPU over.
+  release(&mycpu()->rq->lock);
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -935,6 +1060,7 @@ forkret(void)
     initlog(ROOTDEV);
   }
 
+  tsccharge(myproc(), &myproc()->stsc);
   // Return to "caller", actually trapret (see allocproc).
 }
 
@@ -944,6 +1070,7 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq;
   
   if(p == 0)
     panic("sleep");
@@ -951,76 +1078,175 @@ sleep(void *chan, struct spinlock *lk)
   if(lk == 0)
     panic("sleep without lk");
 
-  // Must acquire ptable.lock in order to
-  // change p->state and then call sched.
-  // Once we hold ptable.lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup runs with ptable.lock locked),
+  // Must acquire chan's wait queue lock in order to
+  // change p->state.
+  // Once we hold it, we can be guaranteed that we
+  // won't miss any wakeup (wakeup runs with it locked),
   // so it's okay to release lk.
-  if(lk != &ptable.lock){  //DOC: sleeplock0
-    acquire(&ptable.lock);  //DOC: sleeplock1
-    release(lk);
-  }
+  wq = waitq(chan);
+  acquire(&wq->lock);  //DOC: sleeplock1
+  release(lk);
+  sleepwq(wq, chan);
+
+  // Reacquire original lock.
+  acquire(lk);  //DOC: sleeplock2
+}
+
+// Sleep on chan, whose wait queue wq the caller has locked.
+// Returns with wq unlocked.
+static void
+sleepwq(struct waitq *wq, void *chan)
+{
+  struct proc *p = myproc();
+
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
-
+  p->sleptat = ticks;
+  wqinsert(wq, p);
+  trace(TR_SLEEP, p, 0);
+
+  // Switch away holding this CPU's run queue lock,
+  // so that a wakeup cannot queue p (and another CPU
+  // cannot run it) until it is off this CPU.
+  rqlock();
+  release(&wq->lock);
   sched();
 
-  // Tidy up.
-  p->chan = 0;
-
-  // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  // Tidy up; the waker has cleared p->chan.
+  release(&mycpu()->rq->lock);
 }
 
 //PAGEBREAK!
-// Wake up all processes sleeping on chan.
-// The ptable lock must be held.
+// Make sleeping p, which is on wq, RUNNABLE.
+// wq must be locked.
 static void
-wakeup1(void *chan)
+unsleep(struct waitq *wq, struct proc *p)
 {
-  struct proc *p;
+  wqremove(wq, p);
+  p->chan = 0;
+  p->iotime += ticks - p->sleptat;
+  p->woken = 1;
+  rqready(p);
+  trace(TR_WAKEUP, p, p->cpu);
+}
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == SLEEPING && p->chan == chan){
-      p->state = RUNNABLE;
-      #ifdef MLFQ
-      if(p->priority==1){
-        c1++;
-        q1[c1-1]=p;
-      }
-      if(p->priority==2){
-        c2++;
-        q2[c2-1]=p;
-      }
-      if(p->priority==3){
-        c3++;
-        q3[c3-1]=p;
-      }
-      if(p->priority==4){
-        c4++;
-        q4[c4-1]=p;
-      }
-      if(p->priority==5){
-        c5++;
-        q5[c5-1]=p;
-      }
-      #endif
-    }
+// Wake up to n processes sleeping on chan, longest
+// sleeper first, or all of them if n is 0.  If leader is
+// set, only its threads are woken.
+// Return the number woken.
+static int
+wakeupn(void *chan, struct proc *leader, int n)
+{
+  struct waitq *wq;
+  struct proc *p, *next;
+  int woken;
+
+  wq = waitq(chan);
+  woken = 0;
+  acquire(&wq->lock);
+  for(p = wq->head; p; p = next){
+    next = p->wqnext;
+    if(p->chan != chan || (leader && p->leader != leader))
+      continue;
+    unsleep(wq, p);
+    woken++;
+    if(--n == 0)
+      break;
   }
+  release(&wq->lock);
+  return woken;
 }
 
 // Wake up all processes sleeping on chan.
 void
 wakeup(void *chan)
 {
-  acquire(&ptable.lock);
-  wakeup1(chan);
-  release(&ptable.lock);
+  wakeupn(chan, 0, 0);
+}
+
+// Wake up the process that has slept longest on chan.
+// A process woken this way that leaves the condition
+// it waited for still true must pass the wakeup on.
+void
+wakeone(void *chan)
+{
+  wakeupn(chan, 0, 1);
+}
+
+// Futexes.  A process blocks on a word of user memory by
+// sleeping on the word's user address, which is below
+// KERNBASE and so no kernel channel, and futexwake()
+// wakes only the threads sharing its address space.  The
+// futex is keyed by address space and address rather than
+// by physical page, since the page moves when a write
+// after fork() copies it.  The wait queue lock orders the
+// check of the word against futexwake(), so a wakeup
+// between them is not lost.
+
+// Read the user word at va into *v.
+static int
+futexword(uint va, uint *v)
+{
+  struct proc *p = myproc();
+  char *ka;
+
+  if(va % sizeof(uint) != 0 || uvmfault(p->pgdir, p->sz, va, 0) < 0)
+    return -1;
+  if((ka = uva2ka(p->pgdir, (char*)va)) == 0)
+    return -1;
+  *v = *(uint*)(ka + (va & (PGSIZE-1)));
+  return 0;
+}
+
+// Sleep on the word at va if it still holds val.
+// Return 0 once woken, -1 if it held something else
+// or the process was killed.
+int
+futexwait(uint va, uint val)
+{
+  struct waitq *wq;
+  uint v;
+
+  wq = waitq((void*)va);
+  acquire(&wq->lock);
+  if(futexword(va, &v) < 0 || v != val || myproc()->killed){
+    release(&wq->lock);
+    return -1;
+  }
+  sleepwq(wq, (void*)va);
+  return myproc()->killed ? -1 : 0;
+}
+
+// Wake up to n threads sleeping on the word at va.
+// Return the number woken.
+int
+futexwake(uint va, int n)
+{
+  if(va % sizeof(uint) != 0 || va >= myproc()->sz)
+    return -1;
+  if(n <= 0)
+    return 0;
+  return wakeupn((void*)va, myproc()->leader, n);
+}
+
+// Mark p killed and wake it if it sleeps.
+// Caller must hold ptable.lock.
+static void
+killproc(struct proc *p)
+{
+  struct waitq *wq;
+
+  p->killed = 1;
+  // p's state and chan only change together
+  // under its wait queue lock, so check again.
+  if(p->state == SLEEPING){
+    wq = waitq(p->chan);
+    acquire(&wq->lock);
+    if(p->state == SLEEPING && waitq(p->chan) == wq)
+      unsleep(wq, p);
+    release(&wq->lock);
+  }
 }
 
 // Kill the process with the given pid.
@@ -1032,25 +1258,20 @@ kill(int pid)
   struct proc *p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING){
-        p->state = RUNNABLE;
-      }
-      release(&ptable.lock);
-      return 0;
-    }
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
   }
+  killproc(p);
   release(&ptable.lock);
-  return -1;
+  return 0;
 }
 
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
-// No lock to avoid wedging a stuck machine further.
+// Holds ptable.lock, since chunks of the table may be
+// given back to kalloc as processes are reaped.
 void
 procdump(void)
 {
@@ -1067,7 +1288,8 @@ procdump(void)
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  acquire(&ptable.lock);
+  for(p = nextslot(0); p; p = nextslot(p)){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -1082,37 +1304,103 @@ procdump(void)
     }
     cprintf("\n");
   }
+  release(&ptable.lock);
 }
 
+// Copy a snapshot of up to n processes, at most NPROC, in
+// the table to the user buffer at va, which the caller has
+// checked.  Return the number copied.
 int
-cps(){
-    struct proc *p;
-    sti();
-    acquire(&ptable.lock);
-    cprintf("name \t pid \t state \t \t priority \n");
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-        if(p->state == RUNNABLE)
-            cprintf("%s \t %d \t RUNNABLE \t %d\n", p->name, p->pid, p->priority);
-        else if(p->state == RUNNING)
-            cprintf("%s \t %d \t RUNNING \t %d\n", p->name, p->pid, p->priority);
-        else if(p->state == SLEEPING)
-            cprintf("%s \t %d \t SLEEPING \t %d\n", p->name, p->pid, p->priority);
-    }
-    release(&ptable.lock);
-    return 24;
+getprocs(uint va, int n)
+{
+  struct proc *p;
+  struct pinfo *pi;
+  int j, cnt;
+
+  acquiresleep(&snap.lock);
+  cnt = 0;
+  acquire(&ptable.lock);
+  for(p = nextslot(0); p && cnt < n; p = nextslot(p)){
+    if(p->state == UNUSED)
+      continue;
+    pi = &snap.info[cnt++];
+    pi->pid = p->pid;
+    pi->ppid = p->parent ? p->parent->pid : 0;
+    pi->state = p->state;
+    pi->priority = p->priority;
+    pi->level = p->level;
+    pi->cpu = p->cpu;
+    pi->rtime = p->rtime;
+    pi->iotime = p->iotime;
+    pi->num_run = p->num_run;
+    for(j = 0; j < 5; j++)
+      pi->ticks[j] = p->cq[j];
+    safestrcpy(pi->name, p->name, sizeof(pi->name));
+  }
+  release(&ptable.lock);
+  if(copyout(myproc()->pgdir, myproc()->sz, va, snap.info,
+             cnt*sizeof(struct pinfo)) < 0)
+    cnt = -1;
+  releasesleep(&snap.lock);
+  return cnt;
 }
 
 // Change priority
 int
 cpr(int pid, int priority){
     struct proc *p;
+    struct runq *rq;
+    int queued;
     acquire(&ptable.lock);
-    for(p=ptable.proc; p<&ptable.proc[NPROC]; p++){
-        if(p->pid == pid){
+    if((p = findproc(pid)) != 0){
+        // A queued process moves to the place
+        // its new priority gives it.  Under MLFQ
+        // the priority is the level to move to.
+        rq = rqlockproc(p);
+        queued = p->state == RUNNABLE;
+        if(queued)
+            rqdequeue(rq, p);
+        if(rqsetpolicy(-1) == SCHED_MLFQ){
+            if(priority < 1)
+                priority = 1;
+            if(priority > NQUEUE)
+                priority = NQUEUE;
+            p->level = priority;
+        } else
             p->priority = priority;
-            break;
-        }
+        if(queued)
+            rqenqueue(rq, p);
+        release(&rq->lock);
     }
     release(&ptable.lock);
     return pid;
 }
+
+// Set the tickets, and so the CPU share under STRIDE,
+// of the process with the given pid.  Its pass stays
+// put; only the rate it advances at changes.
+int
+settickets(int pid, int tickets){
+    struct proc *p;
+    if(tickets < 1 || tickets > MAXTICKETS)
+        return -1;
+    acquire(&ptable.lock);
+    if((p = findproc(pid)) == 0){
+        release(&ptable.lock);
+        return -1;
+    }
+    p->tickets = tickets;
+    release(&ptable.lock);
+    return 0;
+}
+
+int
+gettickets(int pid){
+    struct proc *p;
+    int tickets = -1;
+    acquire(&ptable.lock);
+    if((p = findproc(pid)) != 0)
+        tickets = p->tickets;
+    release(&ptable.lock);
+    return tickets;
+}
@@ -8,6 +8,13 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  struct runq *rq;             // Run queue this cpu dispatches from
+  uint64 idletsc;              // TSC cycles spent halted with nothing to run
+  uint halts;                  // Times it halted with nothing to run
+  uint ipis;                   // Reschedule IPIs received
+  pde_t * volatile pgdir;      // Page table of the running process or null
+  volatile uint tlbreq;        // TLB flushes asked of this cpu
+  volatile uint tlbdone;       // Requests up to which it has flushed
 };
 
 extern struct cpu cpus[NCPU];
@@ -32,16 +39,23 @@ struct context {
   uint eip;
 };
 
-struct procstat{
-    int pid;
-    int runtime;
-    int num_run;
-    int current_queue;
-    int ticks[5];
+// Red-black tree node and root (rbtree.c).
+struct rbnode {
+  struct rbnode *parent;
+  struct rbnode *left;
+  struct rbnode *right;
+  int red;
+};
+
+struct rbroot {
+  struct rbnode *node;         // Root, or 0 if empty
+  struct rbnode *first;        // Leftmost node
 };
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+#define NOINHERIT 1000  // inhpri and inhlevel when nothing is inherited
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -53,18 +67,61 @@ struct proc {
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
+  struct proc *wqnext;         // Wait queue links (proc.c)
+  struct proc *wqprev;
+  uint64 wakeat;               // TSC a timed sleep ends (timer.c)
+  int timeridx;                // Index in the timer heap, or -1
   int killed;                  // If non-zero, have been killed
-  struct file *ofile[NOFILE];  // Open files
-  struct inode *cwd;           // Current directory
+  struct fdtable *fdt;         // Open files and current directory
   char name[16];               // Process name (debugging)
+  struct proc *pidnext;        // Next in its pid hash chain, or free list
+  struct proc *children;       // First child
+  struct proc *sibling;        // Next child of its parent
+  struct proc *leader;         // Owner of its address space, itself if not a thread
+  struct proc *threads;        // Leader: the threads sharing its address space
+  struct proc *tnext;          // Next thread of the same leader
+  int shrinking;               // Leader: growproc() is freeing memory
+  void *ustack;                // Thread: user stack given to clone()
+  struct sleeplock *held;      // Sleep locks held, most recent first
+  int inhpri;                  // Priority inherited from their waiters
+  int inhlevel;                // MLFQ level inherited from their waiters
+  int inversions;              // Waits for a lock held by a lower-ranked process
+  uint64 invtsc;               // TSC cycles spent in those waits
   int ctime;
   int etime;
   int rtime;
   int iotime;
-  int priority;
+  int priority;                // PBS priority and CFS weight, 0 (highest) to 100
+  int level;                   // MLFQ level, 1 (highest) to NQUEUE
   int cq[5];
-  int last_time;
+  int last_time;               // MLFQ: tick it joined its current level
   int num_run; 
+  uint sleptat;                // Tick it last went to sleep
+  uint64 tsc;                  // TSC when its current state began
+  uint64 utsc;                 // TSC cycles run in user mode
+  uint64 stsc;                 // TSC cycles run in the kernel
+  uint64 wtsc;                 // TSC cycles RUNNABLE waiting for a CPU
+  int woken;                   // Made RUNNABLE by a wakeup, not yet run
+  uint lat[NLAT];              // Dispatch latencies, log2 microseconds
+  uint wlat[NLAT];             // Those of dispatches after a wakeup
+  int cpu;                     // CPU whose run queue holds this process
+  int lastcpu;                 // CPU it last ran on, or -1
+  uint lastrun;                // Tick it last stopped running
+  int migrations;              // Times it ran on a different CPU than before
+  int steals;                  // Times an idle CPU took it from its queue
+  struct proc *rqnext;         // Run queue links (runq.c)
+  struct proc *rqprev;
+  struct rbnode rb;            // Run queue tree node (CFS, EDF)
+  uint vruntime;               // Weighted CPU time (CFS)
+  int tickets;                 // Share of the CPU (STRIDE)
+  uint pass;                   // Virtual time of the next run (STRIDE)
+  int heapidx;                 // Index in the run queue heap (STRIDE)
+  int rtruntime;               // Real-time budget per period, in ticks
+  int rtperiod;                // Real-time period in ticks, 0 if not real-time
+  int rtdeadline;              // Ticks into each period the budget is due
+  int rtbudget;                // Budget left in the current period
+  uint rtdl;                   // Absolute deadline of the current period
+  uint rtnext;                 // Tick the next period starts
 };
 
 // Process memory is laid out contiguously, low addresses first:
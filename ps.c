@@ -1,10 +1,29 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
-#include "fcntl.h"
+#include "param.h"
+#include "sysstat.h"
+
+static char *states[] = {
+  "unused", "embryo", "sleep ", "runble", "run   ", "zombie"
+};
+
+static struct pinfo pi[NPROC];
 
 int
-main(int argc, char *argv[]){
-    cps();
+main(int argc, char *argv[])
+{
+  int i, n;
+
+  if((n = getprocs(pi, NPROC)) < 0){
+    printf(2, "ps: getprocs failed\n");
     exit();
+  }
+  printf(1, "pid\tppid\tstate\tprio\tlevel\tcpu\trtime\tiotime\truns\tname\n");
+  for(i = 0; i < n; i++)
+    printf(1, "%d\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%s\n",
+           pi[i].pid, pi[i].ppid, states[pi[i].state], pi[i].priority,
+           pi[i].level, pi[i].cpu, pi[i].rtime, pi[i].iotime,
+           pi[i].num_run, pi[i].name);
+  exit();
 }
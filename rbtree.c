@@ -0,0 +1,285 @@
+// Red-black trees.
+//
+// An intrusive balanced search tree: the nodes are embedded in
+// the objects kept in order, and the caller supplies the order
+// when inserting.  Insertion and removal take O(log n); the
+// leftmost (smallest) node is cached in the root so it can be
+// found in O(1).  Nodes that compare equal stay in insertion
+// order.  The caller provides the locking.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+
+static void
+rotateleft(struct rbroot *t, struct rbnode *x)
+{
+  struct rbnode *y = x->right;
+
+  x->right = y->left;
+  if(y->left)
+    y->left->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    t->node = y;
+  else if(x == x->parent->left)
+    x->parent->left = y;
+  else
+    x->parent->right = y;
+  y->left = x;
+  x->parent = y;
+}
+
+static void
+rotateright(struct rbroot *t, struct rbnode *x)
+{
+  struct rbnode *y = x->left;
+
+  x->left = y->right;
+  if(y->right)
+    y->right->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    t->node = y;
+  else if(x == x->parent->right)
+    x->parent->right = y;
+  else
+    x->parent->left = y;
+  y->right = x;
+  x->parent = y;
+}
+
+static int
+isred(struct rbnode *n)
+{
+  return n != 0 && n->red;
+}
+
+// Insert n into t, after every node that is not greater.
+void
+rbinsert(struct rbroot *t, struct rbnode *n,
+         int (*less)(struct rbnode*, struct rbnode*))
+{
+  struct rbnode **link, *p, *g, *u;
+  int leftmost;
+
+  link = &t->node;
+  p = 0;
+  leftmost = 1;
+  while(*link){
+    p = *link;
+    if(less(n, p))
+      link = &p->left;
+    else {
+      link = &p->right;
+      leftmost = 0;
+    }
+  }
+  n->parent = p;
+  n->left = n->right = 0;
+  n->red = 1;
+  *link = n;
+  if(leftmost)
+    t->first = n;
+
+  // Restore the red-black properties: a red node
+  // never has a red parent.
+  while((p = n->parent) != 0 && p->red){
+    g = p->parent;
+    if(p == g->left){
+      u = g->right;
+      if(isred(u)){
+        p->red = u->red = 0;
+        g->red = 1;
+        n = g;
+        continue;
+      }
+      if(n == p->right){
+        rotateleft(t, p);
+        n = p;
+        p = n->parent;
+      }
+      p->red = 0;
+      g->red = 1;
+      rotateright(t, g);
+    } else {
+      u = g->left;
+      if(isred(u)){
+        p->red = u->red = 0;
+        g->red = 1;
+        n = g;
+        continue;
+      }
+      if(n == p->left){
+        rotateright(t, p);
+        n = p;
+        p = n->parent;
+      }
+      p->red = 0;
+      g->red = 1;
+      rotateleft(t, g);
+    }
+  }
+  t->node->red = 0;
+}
+
+// Put v where u was in the tree.
+static void
+transplant(struct rbroot *t, struct rbnode *u, struct rbnode *v)
+{
+  if(u->parent == 0)
+    t->node = v;
+  else if(u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+  if(v)
+    v->parent = u->parent;
+}
+
+// Remove n from t.
+void
+rberase(struct rbroot *t, struct rbnode *n)
+{
+  struct rbnode *x, *p, *y, *w;
+  int red;
+
+  if(t->first == n)
+    t->first = rbnext(n);
+
+  // Unlink n; x takes the place of the node that was
+  // actually removed, and p is x's new parent.
+  red = n->red;
+  if(n->left == 0){
+    x = n->right;
+    p = n->parent;
+    transplant(t, n, x);
+  } else if(n->right == 0){
+    x = n->left;
+    p = n->parent;
+    transplant(t, n, x);
+  } else {
+    y = n->right;
+    while(y->left)
+      y = y->left;
+    red = y->red;
+    x = y->right;
+    if(y->parent == n)
+      p = y;
+    else {
+      p = y->parent;
+      transplant(t, y, x);
+      y->right = n->right;
+      y->right->parent = y;
+    }
+    transplant(t, n, y);
+    y->left = n->left;
+    y->left->parent = y;
+    y->red = n->red;
+  }
+  if(red)
+    return;
+
+  // A black node went away: x carries an extra black
+  // that has to be pushed up or absorbed.
+  while(x != t->node && !isred(x)){
+    if(x == p->left){
+      w = p->right;
+      if(w->red){
+        w->red = 0;
+        p->red = 1;
+        rotateleft(t, p);
+        w = p->right;
+      }
+      if(!isred(w->left) && !isred(w->right)){
+        w->red = 1;
+        x = p;
+        p = x->parent;
+      } else {
+        if(!isred(w->right)){
+          w->left->red = 0;
+          w->red = 1;
+          rotateright(t, w);
+          w = p->right;
+        }
+        w->red = p->red;
+        p->red = 0;
+        w->right->red = 0;
+        rotateleft(t, p);
+        x = t->node;
+      }
+    } else {
+      w = p->left;
+      if(w->red){
+        w->red = 0;
+        p->red = 1;
+        rotateright(t, p);
+        w = p->left;
+      }
+      if(!isred(w->left) && !isred(w->right)){
+        w->red = 1;
+        x = p;
+        p = x->parent;
+      } else {
+        if(!isred(w->left)){
+          w->right->red = 0;
+          w->red = 1;
+          rotateleft(t, w);
+          w = p->left;
+        }
+        w->red = p->red;
+        p->red = 0;
+        w->left->red = 0;
+        rotateright(t, p);
+        x = t->node;
+      }
+    }
+  }
+  if(x)
+    x->red = 0;
+}
+
+// Return the node after n in order, or 0.
+struct rbnode*
+rbnext(struct rbnode *n)
+{
+  if(n->right){
+    n = n->right;
+    while(n->left)
+      n = n->left;
+    return n;
+  }
+  while(n->parent && n == n->parent->right)
+    n = n->parent;
+  return n->parent;
+}
+
+// Return the node before n in order, or 0.
+struct rbnode*
+rbprev(struct rbnode *n)
+{
+  if(n->left){
+    n = n->left;
+    while(n->right)
+      n = n->right;
+    return n;
+  }
+  while(n->parent && n == n->parent->left)
+    n = n->parent;
+  return n->parent;
+}
+
+// Return the last (largest) node of t, or 0.
+struct rbnode*
+rblast(struct rbroot *t)
+{
+  struct rbnode *n;
+
+  if((n = t->node) == 0)
+    return 0;
+  while(n->right)
+    n = n->right;
+  return n;
+}
@@ -0,0 +1,21 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+// Run a command as a real-time process.
+int
+main(int argc, char *argv[])
+{
+    if(argc < 5){
+        printf(2, "usage: rt runtime period deadline command [args]\n");
+        exit();
+    }
+    if(setrt(atoi(argv[1]), atoi(argv[2]), atoi(argv[3])) < 0){
+        printf(2, "rt: cannot admit %s/%s\n", argv[1], argv[2]);
+        exit();
+    }
+    exec(argv[4], argv+4);
+    printf(2, "rt: exec %s failed\n", argv[4]);
+    exit();
+}
@@ -0,0 +1,1109 @@
+// Per-CPU run queues.
+//
+// Each CPU dispatches from its own queue of RUNNABLE processes,
+// protected by its own lock, so picking the next process costs
+// O(1) and CPUs do not serialize on ptable.lock to find work.
+//
+// The current CPU's queue lock is the lock held across swtch()
+// between a process and the scheduler, the role ptable.lock used
+// to play: sched() must be called holding it, and scheduler() or
+// forkret() releases it on the other side of the switch.
+//
+// A queued process is always RUNNABLE, and it belongs to the
+// queue of p->cpu.  A process that is switching out (yield, sleep,
+// exit) holds its CPU's queue lock until the scheduler has saved
+// its context and charged it for its run (rqcharge), so a process
+// can only be dequeued and run once it has fully left its previous
+// CPU.  This is why wakeups put a process back on the queue of the
+// CPU it last ran on, and why a yielding process is queued by the
+// scheduler after the switch rather than by yield() itself.
+//
+// New processes start on the least-loaded CPU (rqplace), and a
+// CPU whose queue runs dry steals from the busiest one (rqsteal).
+// A CPU with nothing to run at all halts (rqidle); queueing work
+// for it, or more work than one CPU can run anywhere, sends it a
+// reschedule IPI.
+//
+// Lock order: ptable.lock before any run queue lock; two run
+// queue locks are taken in cpus[] order.
+//
+// Real-time processes, made so by rqsetrt(), run before anything
+// the scheduling policy queues.  Each one reserves a budget of
+// p->rtruntime ticks every p->rtperiod ticks, to be used within
+// p->rtdeadline ticks of the start of the period, and the queue
+// keeps them in a red-black tree ordered by absolute deadline
+// (EDF).  A process that has used its budget waits on the
+// throttled list until its next period starts.  Admission keeps
+// the real-time load on each CPU under RTLIMIT percent, so every
+// deadline can be met and the other processes still get to run.
+// Real-time processes are never stolen, so they stay on the CPU
+// that admitted them.
+//
+// The order within a queue is set by the scheduling policy, one
+// of the schedops below.  SCHEDFLAG picks the one in force at
+// boot, and setsched() switches every CPU to another at run time:
+//   DEFAULT  round robin
+//   FCFS     earliest creation time first, never preempted
+//   PBS      smallest priority value first, round robin among equals
+//   MLFQ     one round-robin queue per level, highest level first
+//   CFS      smallest weighted virtual runtime first
+//   STRIDE   smallest pass value first
+//
+// MLFQ levels are FIFOs in the order processes joined them, with
+// p->last_time holding the tick each one did.  A bitmap of the
+// non-empty levels finds the top one with a single bsf, and only
+// the head of a level can have waited long enough to be promoted.
+//
+// CFS keeps its queue in a red-black tree ordered by p->vruntime,
+// the CPU time p has had scaled down by its weight, so the next
+// process is the cached leftmost node and a switch costs O(log n).
+// Weights come from p->priority as set by cpr(): priority 60 is
+// nice 0, and every two points below or above it is one nice level.
+// rq->minvruntime follows the smallest vruntime dispatched here;
+// a process joining the queue is placed no more than SLEEPCREDIT
+// ahead of it, so sleeping does not bank unlimited CPU time.
+//
+// STRIDE gives each process a share of its CPU proportional to
+// p->tickets.  Every tick p runs adds STRIDE1/tickets to p->pass,
+// and the queue is a binary min-heap on pass.  rq->minpass is the
+// pass of the last process dispatched; a process joining the queue
+// starts no lower than that, so it cannot claim the CPU for the
+// time it spent asleep or on another queue.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "traps.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sched.h"
+#include "runq.h"
+#include "trace.h"
+
+struct runq runqs[NCPU];
+
+void
+rqinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++){
+    initlock(&runqs[i].lock, "runq");
+    runqs[i].cpu = i;
+    cpus[i].rq = &runqs[i];
+  }
+}
+
+// Lock and return the current CPU's run queue.
+struct runq*
+rqlock(void)
+{
+  struct runq *rq;
+
+  pushcli();
+  rq = mycpu()->rq;
+  acquire(&rq->lock);
+  popcli();
+  return rq;
+}
+
+// Lock and return the run queue p belongs to.
+// p->cpu only changes with that queue locked,
+// so check it again once the lock is held.
+struct runq*
+rqlockproc(struct proc *p)
+{
+  struct runq *rq;
+
+  for(;;){
+    rq = cpus[p->cpu].rq;
+    acquire(&rq->lock);
+    if(rq == cpus[p->cpu].rq)
+      return rq;
+    release(&rq->lock);
+  }
+}
+
+// Insert p into l before q, or at the tail if q is 0.
+static void
+listinsert(struct rqlist *l, struct proc *q, struct proc *p)
+{
+  p->rqnext = q;
+  if(q){
+    p->rqprev = q->rqprev;
+    q->rqprev = p;
+  } else {
+    p->rqprev = l->tail;
+    l->tail = p;
+  }
+  if(p->rqprev)
+    p->rqprev->rqnext = p;
+  else
+    l->head = p;
+}
+
+static void
+listremove(struct rqlist *l, struct proc *p)
+{
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    l->head = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    l->tail = p->rqprev;
+  p->rqnext = p->rqprev = 0;
+}
+
+static struct proc*
+rbproc(struct rbnode *n)
+{
+  if(n == 0)
+    return 0;
+  return (struct proc*)((char*)n - (uint)&((struct proc*)0)->rb);
+}
+
+// Deadlines wrap around like ticks, so compare
+// them by the sign of their difference.
+static int
+dlless(struct rbnode *a, struct rbnode *b)
+{
+  return (int)(rbproc(a)->rtdl - rbproc(b)->rtdl) < 0;
+}
+
+// Wake halted CPUs that should look for work after p was
+// queued on rq: its owner, and if p has to wait behind another
+// process, queued or running on the owner, an idle CPU that
+// can steal it.  Other CPUs' idle flags and current processes
+// are read unlocked; a stale one costs a spurious IPI or leaves
+// the work for the next tick.
+static void
+rqkick(struct runq *rq, struct proc *p)
+{
+  struct proc *cur;
+  int i;
+
+  if(rq->idle && rq != mycpu()->rq){
+    rq->idle = 0;
+    lapicipi(cpus[rq->cpu].apicid, T_IRQ0 + IRQ_RESCHED);
+    return;
+  }
+  cur = cpus[rq->cpu].proc;
+  if(rq->n < 2 && (rq->n < 1 || cur == 0 || cur == p))
+    return;
+  for(i = 0; i < ncpu; i++){
+    if(runqs[i].idle && &runqs[i] != rq && &runqs[i] != mycpu()->rq){
+      lapicipi(cpus[i].apicid, T_IRQ0 + IRQ_RESCHED);
+      return;
+    }
+  }
+}
+
+// Queue real-time p on rq.  If its period is over it starts
+// a new one with a full budget; if it has used its budget it
+// waits on the throttled list, ordered by next period.
+static void
+rtenqueue(struct runq *rq, struct proc *p)
+{
+  struct proc *q;
+
+  if((int)(ticks - p->rtnext) >= 0){
+    p->rtbudget = p->rtruntime;
+    p->rtdl = ticks + p->rtdeadline;
+    p->rtnext = ticks + p->rtperiod;
+  }
+  if(p->rtbudget > 0)
+    rbinsert(&rq->rt, &p->rb, dlless);
+  else {
+    for(q = rq->throttled.head; q; q = q->rqnext)
+      if((int)(p->rtnext - q->rtnext) < 0)
+        break;
+    listinsert(&rq->throttled, q, p);
+  }
+  rq->nrt++;
+  rqkick(rq, p);
+}
+
+// The budget of a queued process does not change,
+// so it tells which of the two p is on.
+static void
+rtdequeue(struct runq *rq, struct proc *p)
+{
+  rq->nrt--;
+  if(p->rtbudget > 0)
+    rberase(&rq->rt, &p->rb);
+  else
+    listremove(&rq->throttled, p);
+}
+
+// The priority and MLFQ level p is scheduled at: its own,
+// or better ones inherited through sleep locks it holds.
+int
+rqprio(struct proc *p)
+{
+  return p->inhpri < p->priority ? p->inhpri : p->priority;
+}
+
+int
+rqlevel(struct proc *p)
+{
+  return p->inhlevel < p->level ? p->inhlevel : p->level;
+}
+
+// Round robin, FCFS and PBS keep one list in dispatch order.
+
+static void
+rrenqueue(struct runq *rq, struct proc *p)
+{
+  listinsert(&rq->list, 0, p);
+}
+
+static void
+fcfsenqueue(struct runq *rq, struct proc *p)
+{
+  struct proc *q;
+
+  for(q = rq->list.head; q; q = q->rqnext)
+    if(p->ctime < q->ctime)
+      break;
+  listinsert(&rq->list, q, p);
+}
+
+static void
+pbsenqueue(struct runq *rq, struct proc *p)
+{
+  struct proc *q;
+
+  for(q = rq->list.head; q; q = q->rqnext)
+    if(rqprio(p) < rqprio(q))  // larger value, lower priority
+      break;
+  listinsert(&rq->list, q, p);
+}
+
+static void
+listdequeue(struct runq *rq, struct proc *p)
+{
+  listremove(&rq->list, p);
+}
+
+static struct proc*
+listpick(struct runq *rq)
+{
+  return rq->list.head;
+}
+
+static struct proc*
+listbefore(struct runq *rq, struct proc *p)
+{
+  if(p)
+    return p->rqprev;
+  return rq->list.tail;
+}
+
+static int
+preempt(struct proc *p)
+{
+  return 1;
+}
+
+static int
+nopreempt(struct proc *p)
+{
+  return 0;
+}
+
+// MLFQ: one FIFO per level, level 1 the highest.
+
+static int clicks_per_queue[NQUEUE] = {1, 2, 4, 8, 16};
+
+static void
+mlfqenqueue(struct runq *rq, struct proc *p)
+{
+  int i = rqlevel(p) - 1;
+
+  listinsert(&rq->level[i], 0, p);
+  p->last_time = ticks;
+  rq->bitmap |= 1 << i;
+}
+
+static void
+mlfqdequeue(struct runq *rq, struct proc *p)
+{
+  int i = rqlevel(p) - 1;
+
+  listremove(&rq->level[i], p);
+  if(rq->level[i].head == 0)
+    rq->bitmap &= ~(1 << i);
+}
+
+// Move processes that have waited more than AGETICKS
+// in a lower level up one level.  Only level heads can
+// be due, and nothing changes until the next tick.
+static void
+mlfqage(struct runq *rq)
+{
+  struct proc *p;
+  uint levels;
+  int i;
+
+  if(rq->aged == ticks)
+    return;
+  rq->aged = ticks;
+  for(levels = rq->bitmap & ~1; levels; levels &= levels-1){
+    i = bsf(levels);
+    while((p = rq->level[i].head) != 0 && ticks - p->last_time > AGETICKS){
+      mlfqdequeue(rq, p);
+      // Its own level, not the one it inherits.
+      if(p->level > 1)
+        p->level--;
+      mlfqenqueue(rq, p);
+      trace(TR_PROMOTE, p, p->level);
+    }
+  }
+}
+
+static struct proc*
+mlfqpick(struct runq *rq)
+{
+  mlfqage(rq);
+  if(rq->bitmap == 0)
+    return 0;
+  return rq->level[bsf(rq->bitmap)].head;
+}
+
+static struct proc*
+mlfqbefore(struct runq *rq, struct proc *p)
+{
+  int i;
+
+  if(p && p->rqprev)
+    return p->rqprev;
+  for(i = p ? rqlevel(p)-2 : NQUEUE-1; i >= 0; i--)
+    if(rq->level[i].tail)
+      return rq->level[i].tail;
+  return 0;
+}
+
+// Demote a process that used up its quantum at this
+// level.  The lowest level just round-robins.
+static void
+mlfqyield(struct proc *p)
+{
+  if(p->level < NQUEUE &&
+     p->cq[p->level-1] >= clicks_per_queue[p->level-1]){
+    p->level++;
+    trace(TR_DEMOTE, p, p->level);
+  } else if(p->level < NQUEUE ||
+          p->cq[NQUEUE-1] <= clicks_per_queue[NQUEUE-1])
+    p->cq[p->level-1]++;
+}
+
+// CFS: a red-black tree ordered by vruntime.
+
+#define SLEEPCREDIT (3<<10)  // 3 ticks at nice 0
+
+// Weight of each nice level from -20 to 19: each level
+// gets about 25% less CPU than the level before it.
+static int cfsweight[40] = {
+  88761, 71755, 56483, 46273, 36291,
+  29154, 23254, 18705, 14949, 11916,
+  9548, 7620, 6100, 4904, 3906,
+  3121, 2501, 1991, 1586, 1277,
+  1024, 820, 655, 526, 423,
+  335, 272, 215, 172, 137,
+  110, 87, 70, 56, 45,
+  36, 29, 23, 18, 15,
+};
+
+static int
+weight(struct proc *p)
+{
+  int nice;
+
+  nice = (p->priority - 60) / 2;
+  if(nice < -20)
+    nice = -20;
+  if(nice > 19)
+    nice = 19;
+  return cfsweight[nice+20];
+}
+
+// Virtual runtimes wrap around, so compare
+// them by the sign of their difference.
+static int
+vless(struct rbnode *a, struct rbnode *b)
+{
+  return (int)(rbproc(a)->vruntime - rbproc(b)->vruntime) < 0;
+}
+
+static void
+cfsenqueue(struct runq *rq, struct proc *p)
+{
+  if((int)(p->vruntime - (rq->minvruntime - SLEEPCREDIT)) < 0)
+    p->vruntime = rq->minvruntime - SLEEPCREDIT;
+  rbinsert(&rq->tree, &p->rb, vless);
+}
+
+static void
+cfsdequeue(struct runq *rq, struct proc *p)
+{
+  rberase(&rq->tree, &p->rb);
+}
+
+static struct proc*
+cfspick(struct runq *rq)
+{
+  struct proc *p;
+
+  p = rbproc(rq->tree.first);
+  if(p && (int)(p->vruntime - rq->minvruntime) > 0)
+    rq->minvruntime = p->vruntime;
+  return p;
+}
+
+static struct proc*
+cfsbefore(struct runq *rq, struct proc *p)
+{
+  return rbproc(p ? rbprev(&p->rb) : rblast(&rq->tree));
+}
+
+// n is in 1024ths of a tick, so a process that blocks
+// or yields between ticks still pays for its run.
+static void
+cfscharge(struct proc *p, uint n)
+{
+  p->vruntime += ((uint64)n * ((1<<20) / weight(p))) >> 10;
+}
+
+// Keep p's lead or lag relative to the new queue.
+static void
+cfsmove(struct runq *from, struct runq *to, struct proc *p)
+{
+  p->vruntime += to->minvruntime - from->minvruntime;
+}
+
+// STRIDE: a binary min-heap on pass.
+
+#define STRIDE1 (1<<20)
+
+// Pass values wrap around, so compare
+// them by the sign of their difference.
+static int
+passless(struct proc *a, struct proc *b)
+{
+  return (int)(a->pass - b->pass) < 0;
+}
+
+static void
+heapset(struct runq *rq, int i, struct proc *p)
+{
+  rq->heap[i] = p;
+  p->heapidx = i;
+}
+
+// Move the process at heap index i up to its place.
+static void
+heapup(struct runq *rq, int i)
+{
+  struct proc *p;
+  int parent;
+
+  p = rq->heap[i];
+  while(i > 0 && passless(p, rq->heap[parent = (i-1)/2])){
+    heapset(rq, i, rq->heap[parent]);
+    i = parent;
+  }
+  heapset(rq, i, p);
+}
+
+// Move the process at heap index i down to its place.
+static void
+heapdown(struct runq *rq, int i)
+{
+  struct proc *p;
+  int child;
+
+  p = rq->heap[i];
+  while((child = 2*i+1) < rq->n){
+    if(child+1 < rq->n && passless(rq->heap[child+1], rq->heap[child]))
+      child++;
+    if(!passless(rq->heap[child], p))
+      break;
+    heapset(rq, i, rq->heap[child]);
+    i = child;
+  }
+  heapset(rq, i, p);
+}
+
+// The heap holds rq->n processes, which rqenqueue()
+// counts after and rqdequeue() before calling these.
+static void
+strideenqueue(struct runq *rq, struct proc *p)
+{
+  if((int)(p->pass - rq->minpass) < 0)
+    p->pass = rq->minpass;
+  heapset(rq, rq->n, p);
+  heapup(rq, rq->n);
+}
+
+// Fill p's slot with the last element of the heap.
+static void
+stridedequeue(struct runq *rq, struct proc *p)
+{
+  struct proc *last;
+
+  last = rq->heap[rq->n];
+  if(last != p){
+    heapset(rq, p->heapidx, last);
+    heapdown(rq, last->heapidx);
+    heapup(rq, last->heapidx);
+  }
+}
+
+static struct proc*
+stridepick(struct runq *rq)
+{
+  struct proc *p;
+
+  p = rq->n ? rq->heap[0] : 0;
+  if(p && (int)(p->pass - rq->minpass) > 0)
+    rq->minpass = p->pass;
+  return p;
+}
+
+// The heap has no total order; its tail is a fair guess.
+static struct proc*
+stridebefore(struct runq *rq, struct proc *p)
+{
+  if(p == 0)
+    return rq->n ? rq->heap[rq->n-1] : 0;
+  return p->heapidx ? rq->heap[p->heapidx-1] : 0;
+}
+
+// n is in 1024ths of a tick, as for CFS.
+static void
+stridecharge(struct proc *p, uint n)
+{
+  p->pass += ((uint64)n * (STRIDE1 / p->tickets)) >> 10;
+}
+
+static void
+stridemove(struct runq *from, struct runq *to, struct proc *p)
+{
+  p->pass += to->minpass - from->minpass;
+}
+
+// A scheduling policy.  Every operation is called with
+// the run queue locked; those that may be 0 are optional.
+struct schedops {
+  void (*enqueue)(struct runq*, struct proc*);
+  void (*dequeue)(struct runq*, struct proc*);
+  struct proc *(*pick)(struct runq*);    // Next to run, left queued
+  struct proc *(*before)(struct runq*, struct proc*);  // See rqbefore
+  int (*tick)(struct proc*);             // Preempt the running process?
+  void (*yield)(struct proc*);           // It gives up the CPU
+  void (*charge)(struct proc*, uint);    // It ran for n 1024ths of a tick
+  void (*move)(struct runq*, struct runq*, struct proc*);  // Stolen
+};
+
+static struct schedops schedops[NSCHED] = {
+[SCHED_DEFAULT] { rrenqueue, listdequeue, listpick, listbefore,
+                  preempt, 0, 0, 0 },
+[SCHED_FCFS]    { fcfsenqueue, listdequeue, listpick, listbefore,
+                  nopreempt, 0, 0, 0 },
+[SCHED_PBS]     { pbsenqueue, listdequeue, listpick, listbefore,
+                  preempt, 0, 0, 0 },
+[SCHED_MLFQ]    { mlfqenqueue, mlfqdequeue, mlfqpick, mlfqbefore,
+                  preempt, mlfqyield, 0, 0 },
+[SCHED_CFS]     { cfsenqueue, cfsdequeue, cfspick, cfsbefore,
+                  preempt, 0, cfscharge, cfsmove },
+[SCHED_STRIDE]  { strideenqueue, stridedequeue, stridepick, stridebefore,
+                  preempt, 0, stridecharge, stridemove },
+};
+
+// The policy in force, which only changes with
+// every run queue locked (rqsetpolicy).
+#if defined(FCFS)
+static struct schedops *policy = &schedops[SCHED_FCFS];
+#elif defined(PBS)
+static struct schedops *policy = &schedops[SCHED_PBS];
+#elif defined(MLFQ)
+static struct schedops *policy = &schedops[SCHED_MLFQ];
+#elif defined(CFS)
+static struct schedops *policy = &schedops[SCHED_CFS];
+#elif defined(STRIDE)
+static struct schedops *policy = &schedops[SCHED_STRIDE];
+#else
+static struct schedops *policy = &schedops[SCHED_DEFAULT];
+#endif
+
+// Add RUNNABLE p to rq, which must be locked.
+void
+rqenqueue(struct runq *rq, struct proc *p)
+{
+  if(!holding(&rq->lock))
+    panic("rqenqueue");
+  p->cpu = rq->cpu;
+  if(p->rtperiod){
+    rtenqueue(rq, p);
+    return;
+  }
+  policy->enqueue(rq, p);
+  rq->n++;
+  rqkick(rq, p);
+}
+
+// Remove queued p from rq, which must be locked.
+void
+rqdequeue(struct runq *rq, struct proc *p)
+{
+  if(!holding(&rq->lock))
+    panic("rqdequeue");
+  if(p->rtperiod){
+    rtdequeue(rq, p);
+    return;
+  }
+  rq->n--;
+  policy->dequeue(rq, p);
+}
+
+// Remove and return the next process to run from rq,
+// which must be locked, or 0 if the queue is empty.
+struct proc*
+rqpick(struct runq *rq)
+{
+  struct proc *p;
+
+  if(!holding(&rq->lock))
+    panic("rqpick");
+
+  // Real-time processes first, earliest deadline first.
+  while((p = rq->throttled.head) != 0 && (int)(ticks - p->rtnext) >= 0){
+    rtdequeue(rq, p);
+    rtenqueue(rq, p);
+  }
+  if((p = rbproc(rq->rt.first)) != 0){
+    rtdequeue(rq, p);
+    return p;
+  }
+
+  if((p = policy->pick(rq)) != 0)
+    rqdequeue(rq, p);
+  return p;
+}
+
+// Return the process queued just ahead of p in dispatch
+// order, or the last queued process if p is 0.
+static struct proc*
+rqbefore(struct runq *rq, struct proc *p)
+{
+  return policy->before(rq, p);
+}
+
+// Take np off its run queue for the process running on
+// this CPU to hand the CPU straight to, moving it from
+// another CPU if need be.  Return whether np was taken;
+// it must be queued and not real-time.  Returns with
+// this CPU's run queue locked either way.
+int
+rqtake(struct proc *np)
+{
+  struct runq *rq, *nrq;
+  int taken;
+
+  pushcli();
+  rq = mycpu()->rq;
+  for(;;){
+    nrq = cpus[np->cpu].rq;
+    if(nrq == rq)
+      acquire(&rq->lock);
+    else if(nrq < rq){
+      acquire(&nrq->lock);
+      acquire(&rq->lock);
+    } else {
+      acquire(&rq->lock);
+      acquire(&nrq->lock);
+    }
+    if(nrq == cpus[np->cpu].rq)
+      break;
+    if(nrq != rq)
+      release(&nrq->lock);
+    release(&rq->lock);
+  }
+  taken = np->state == RUNNABLE && np->rtperiod == 0;
+  if(taken){
+    rqdequeue(nrq, np);
+    np->cpu = rq->cpu;
+  }
+  if(nrq != rq)
+    release(&nrq->lock);
+  popcli();
+  return taken;
+}
+
+// Called by the scheduler of the idle CPU owning rq, holding
+// no locks: move up to half of the busiest other CPU's queue
+// to rq, taking the processes that would wait longest there.
+// A process that ran on the victim in the last MIGRATECOST
+// ticks is probably still cache-hot and is left alone, unless
+// this CPU has been idle at least that long itself.
+// Return the number of processes moved.
+int
+rqsteal(struct runq *rq)
+{
+  struct runq *victim;
+  struct proc *p, *prev;
+  int i, n, want, idle;
+
+  victim = 0;
+  for(i = 0; i < ncpu; i++)
+    if(&runqs[i] != rq && runqs[i].n > 0 &&
+       (victim == 0 || runqs[i].n > victim->n))
+      victim = &runqs[i];
+  if(victim == 0)
+    return 0;
+
+  // Lock both queues in cpus[] order, so two CPUs
+  // stealing from each other cannot deadlock.
+  if(victim < rq){
+    acquire(&victim->lock);
+    acquire(&rq->lock);
+  } else {
+    acquire(&rq->lock);
+    acquire(&victim->lock);
+  }
+  idle = ticks - rq->active >= MIGRATECOST;
+  want = (victim->n + 1) / 2;
+  n = 0;
+  for(p = rqbefore(victim, 0); p && n < want; p = prev){
+    prev = rqbefore(victim, p);
+    if(!idle && p->lastcpu == victim->cpu && ticks - p->lastrun < MIGRATECOST)
+      continue;
+    rqdequeue(victim, p);
+    if(policy->move)
+      policy->move(victim, rq, p);
+    rqenqueue(rq, p);
+    p->steals++;
+    n++;
+  }
+  rq->steals += n;
+  release(&victim->lock);
+  release(&rq->lock);
+  return n;
+}
+
+// Called by the scheduler of the CPU owning rq, holding the
+// lock, when there is nothing to run: halt until an interrupt,
+// a timer tick or a reschedule IPI.  Returns with rq locked.
+// With TICKLESS, CPUs other than CPU 0, which keeps the clock,
+// also stop their timer while they halt, unless a throttled
+// real-time process will need the CPU when its period starts.
+void
+rqidle(struct runq *rq)
+{
+  struct cpu *c;
+  uint64 t;
+  int tickless;
+
+  rq->idle = 1;
+  release(&rq->lock);
+
+  // An IPI that arrived before cli has already been taken, so
+  // look at the queue again; one arriving after it stays pending
+  // until sti, whose effect is delayed until hlt has started.
+  cli();
+  c = mycpu();
+  if(rq->n == 0 && rq->rt.first == 0 && rq->idle){
+#ifdef TICKLESS
+    tickless = rq->cpu != 0 && rq->nrt == 0;
+#else
+    tickless = 0;
+#endif
+    if(tickless)
+      lapictimer(0);
+    t = rdtsc();
+    asm volatile("sti; hlt");
+    cli();
+    c->idletsc += rdtsc() - t;
+    c->halts++;
+    if(tickless)
+      lapictimer(1);
+  }
+  sti();
+  acquire(&rq->lock);
+  rq->idle = 0;
+}
+
+// Charge p for running n ticks, or cyc TSC cycles.
+void
+rqcharge(struct proc *p, uint n, uint64 cyc)
+{
+  if(p->rtperiod){
+    p->rtbudget -= n;
+    return;
+  }
+  if(policy->charge)
+    policy->charge(p, tscfrac(cyc));
+}
+
+// Histogram bucket of a wait of us microseconds.
+static int
+latbucket(uint us)
+{
+  uint b;
+
+  if(us == 0)
+    return 0;
+  b = bsr(us) + 1;
+  return b < NLAT ? b : NLAT-1;
+}
+
+// Record that p waited n TSC cycles on rq before being
+// dispatched.  Called by scheduler() with rq locked.
+void
+rqlatency(struct runq *rq, struct proc *p, uint64 n)
+{
+  int b, pol;
+
+  b = latbucket(tscus(n));
+  pol = policy - schedops;
+  p->lat[b]++;
+  rq->lat[pol][b]++;
+  if(p->woken){
+    p->wlat[b]++;
+    rq->wlat[pol][b]++;
+    p->woken = 0;
+  }
+}
+
+// Add up the latency histograms of policy pol over every CPU.
+void
+rqlatsum(int pol, uint *lat, uint *wlat)
+{
+  struct runq *rq;
+  int i, b;
+
+  for(i = 0; i < ncpu; i++){
+    rq = &runqs[i];
+    acquire(&rq->lock);
+    for(b = 0; b < NLAT; b++){
+      lat[b] += rq->lat[pol][b];
+      wlat[b] += rq->wlat[pol][b];
+    }
+    release(&rq->lock);
+  }
+}
+
+// Called by yield() with p's run queue locked, before p
+// gives up the CPU while still RUNNABLE.
+void
+rqyield(struct proc *p)
+{
+  if(policy->yield)
+    policy->yield(p);
+}
+
+// Switch every CPU to scheduling policy pol and move the
+// queued processes over to it, keeping their dispatch order
+// as far as the new policy allows.  Processes that are not
+// queued join the new policy the next time they are.  Return
+// the previous policy, or -1 if pol is not a policy; with pol
+// -1, just return the current one.
+int
+rqsetpolicy(int pol)
+{
+  static struct proc *moving[NPROC];
+  struct runq *rq;
+  struct proc *p;
+  int i, n, old;
+
+  if(pol == -1)
+    return policy - schedops;
+  if(pol < 0 || pol >= NSCHED)
+    return -1;
+
+  for(i = 0; i < ncpu; i++)
+    acquire(&runqs[i].lock);
+  old = policy - schedops;
+  // Take every queue apart from the back, so putting
+  // them together again from the front of moving[]
+  // keeps each one's order.  p->cpu says where p was.
+  n = 0;
+  for(i = 0; i < ncpu; i++){
+    rq = &runqs[i];
+    while((p = rqbefore(rq, 0)) != 0){
+      rqdequeue(rq, p);
+      moving[n++] = p;
+    }
+  }
+  policy = &schedops[pol];
+  while(n > 0){
+    p = moving[--n];
+    rqenqueue(&runqs[p->cpu], p);
+  }
+  for(i = ncpu-1; i >= 0; i--)
+    release(&runqs[i].lock);
+  return old;
+}
+
+// Whether a ranks above b under the current policy.
+// Only PBS and MLFQ rank processes.
+int
+rqoutranks(struct proc *a, struct proc *b)
+{
+  if(policy == &schedops[SCHED_PBS])
+    return rqprio(a) < rqprio(b);
+  if(policy == &schedops[SCHED_MLFQ])
+    return rqlevel(a) < rqlevel(b);
+  return 0;
+}
+
+// Set the priority and MLFQ level p inherits from the
+// waiters for its sleep locks, moving it in its queue.
+void
+rqinherit(struct proc *p, int pri, int level)
+{
+  struct runq *rq;
+  int queued;
+
+  rq = rqlockproc(p);
+  if(p->inhpri != pri || p->inhlevel != level){
+    queued = p->state == RUNNABLE;
+    if(queued)
+      rqdequeue(rq, p);
+    p->inhpri = pri;
+    p->inhlevel = level;
+    if(queued)
+      rqenqueue(rq, p);
+  }
+  release(&rq->lock);
+}
+
+// Make p RUNNABLE on the queue of the CPU it last ran on.
+// The caller has just taken p out of EMBRYO or SLEEPING.
+void
+rqready(struct proc *p)
+{
+  struct runq *rq;
+
+  rq = rqlockproc(p);
+  p->state = RUNNABLE;
+  p->tsc = rdtsc();  // its wait starts now
+  rqenqueue(rq, p);
+  release(&rq->lock);
+}
+
+// Choose the CPU a new process starts on: the one with the
+// fewest processes queued or running, preferring this one.
+// The counts are read without locks; a stale answer only
+// costs some balance.  Must be called with interrupts disabled.
+int
+rqplace(void)
+{
+  int i, best, load, bestload;
+
+  best = cpuid();
+  bestload = runqs[best].n + runqs[best].nrt + (cpus[best].proc != 0);
+  for(i = 0; i < ncpu; i++){
+    load = runqs[i].n + runqs[i].nrt + (cpus[i].proc != 0);
+    if(load < bestload){
+      best = i;
+      bestload = load;
+    }
+  }
+  return best;
+}
+
+// Wait until p, which has exited, is off its CPU.
+// p keeps running on its kernel stack until the
+// scheduler on p->cpu drops the run queue lock,
+// so the stack must not be freed before then.
+void
+rqdrain(struct proc *p)
+{
+  struct runq *rq;
+
+  rq = rqlockproc(p);
+  release(&rq->lock);
+}
+
+// Whether the process running on this CPU should be preempted
+// for a real-time one even under FCFS: one is queued and has
+// budget, a throttled one's period has started, or the current
+// process is real-time and has a budget to enforce.
+static int
+rqrtdue(void)
+{
+  struct runq *rq;
+  struct proc *p;
+  int due;
+
+  pushcli();
+  rq = mycpu()->rq;
+  p = rq->throttled.head;
+  due = rq->rt.first != 0 || (p && (int)(ticks - p->rtnext) >= 0) ||
+        (mycpu()->proc && mycpu()->proc->rtperiod);
+  popcli();
+  return due;
+}
+
+// Whether the timer tick should preempt p, the process
+// running on this CPU: if the policy preempts at all, or
+// a real-time process needs the CPU.
+int
+rqtick(struct proc *p)
+{
+  return policy->tick(p) || rqrtdue();
+}
+
+// Percent of a CPU a process reserves with
+// runtime ticks due within deadline ticks.
+// Computed in 64 bits, since runtime*100 can
+// overflow 32.
+static int
+rtload(int runtime, int deadline)
+{
+  if(runtime == 0)
+    return 0;
+  return udiv64((uint64)runtime*100 + deadline - 1, deadline);
+}
+
+// Make p, the current process, real-time with a budget of
+// runtime ticks every period ticks, due deadline ticks into
+// each period (deadline 0 means the end of the period), or
+// return p to the normal policy if runtime is 0.  Return -1
+// if the parameters are invalid or p does not fit in what
+// is left of RTLIMIT on this CPU.
+int
+rqsetrt(struct proc *p, int runtime, int period, int deadline)
+{
+  struct runq *rq;
+  int load;
+
+  if(deadline == 0)
+    deadline = period;
+  if(runtime < 0 || (runtime > 0 && (runtime > deadline || deadline > period)))
+    return -1;
+
+  rq = rqlock();
+  load = rq->rtload + rtload(runtime, deadline);
+  if(p->rtperiod)
+    load -= rtload(p->rtruntime, p->rtdeadline);
+  if(load > RTLIMIT){
+    release(&rq->lock);
+    return -1;
+  }
+  rq->rtload = load;
+  p->rtruntime = runtime;
+  p->rtperiod = runtime ? period : 0;
+  p->rtdeadline = deadline;
+  p->rtbudget = runtime;
+  p->rtdl = ticks + deadline;
+  p->rtnext = ticks + period;
+  release(&rq->lock);
+  return 0;
+}
@@ -0,0 +1,36 @@
+// Intrusive list of queued processes, linked through
+// proc.rqnext and proc.rqprev.
+struct rqlist {
+  struct proc *head;
+  struct proc *tail;
+};
+
+// Per-CPU run queue of RUNNABLE processes.
+struct runq {
+  struct spinlock lock;
+  int cpu;                     // Index of the owning CPU in cpus[]
+  int n;                       // Number of queued processes
+  uint active;                 // Tick this CPU last ran a process
+  uint64 activetsc;            // TSC when it last dispatched one
+  uint steals;                 // Processes this CPU took from others
+  uint migrations;             // Dispatches of processes last run elsewhere
+  int idle;                    // Owner is halted or about to halt
+  int nrt;                     // Number of queued real-time processes
+  int rtload;                  // Percent of the CPU reserved by them
+  struct rbroot rt;            // Real-time processes with budget, by deadline
+  struct rqlist throttled;     // Those out of budget, by next period
+  // Only the current policy's fields hold processes.
+  struct rqlist list;          // DEFAULT, FCFS, PBS: in dispatch order
+  struct rqlist level[NQUEUE]; // MLFQ: one FIFO per level
+  uint bitmap;                 // MLFQ: bit i set while level[i] is non-empty
+  uint aged;                   // MLFQ: tick of the last aging pass
+  struct rbroot tree;          // CFS: processes by vruntime
+  uint minvruntime;            // CFS: smallest vruntime dispatched here
+  struct proc *heap[NPROC];    // STRIDE: min-heap on pass
+  uint minpass;                // STRIDE: pass of the last process dispatched
+  // Dispatch latencies of the processes run here, by the
+  // policy in force: RUNNABLE to RUNNING, and the part of
+  // those that began with a wakeup.
+  uint lat[NSCHED][NLAT];
+  uint wlat[NSCHED][NLAT];
+};
@@ -0,0 +1,8 @@
+// Scheduling policies for setsched().
+#define SCHED_DEFAULT  0   // round robin
+#define SCHED_FCFS     1   // first come first served
+#define SCHED_PBS      2   // priority based
+#define SCHED_MLFQ     3   // multilevel feedback queue
+#define SCHED_CFS      4   // weighted fair share of virtual runtime
+#define SCHED_STRIDE   5   // proportional share by tickets
+#define NSCHED         6
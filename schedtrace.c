@@ -0,0 +1,70 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "trace.h"
+
+#define NEV 256
+#define NCPUS 8
+
+// Drain the scheduler trace and print, for each CPU, who
+// ran from which tick to which and why they stopped.
+// With -v, print every event instead.
+
+static struct traceev ev[NEV];
+static char *names[] = {
+[TR_DISPATCH] "dispatch",
+[TR_PREEMPT]  "preempt",
+[TR_SLEEP]    "sleep",
+[TR_WAKEUP]   "wakeup",
+[TR_DEMOTE]   "demote",
+[TR_PROMOTE]  "promote",
+[TR_EXIT]     "exit",
+};
+
+// The dispatch each CPU is running, if any.
+static struct traceev running[NCPUS];
+
+static void
+timeline(struct traceev *e)
+{
+  struct traceev *r;
+
+  if(e->cpu >= NCPUS)
+    return;
+  r = &running[e->cpu];
+  switch(e->type){
+  case TR_DISPATCH:
+    *r = *e;
+    break;
+  case TR_PREEMPT:
+  case TR_SLEEP:
+  case TR_EXIT:
+    if(r->type != TR_DISPATCH || r->pid != e->pid)
+      break;
+    printf(1, "cpu%d %d-%d\tpid %d\t%d kcycles\t%s\n", e->cpu,
+           r->tick, e->tick, e->pid, (uint)(e->tsc - r->tsc) / 1000,
+           names[e->type]);
+    r->type = 0;
+    break;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, verbose;
+
+  verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+  if(verbose)
+    printf(1, "tick\tcpu\tpid\tevent\targ\n");
+  while((n = traceread(ev, NEV)) > 0){
+    for(i = 0; i < n; i++){
+      if(verbose)
+        printf(1, "%d\t%d\t%d\t%s\t%d\n", ev[i].tick, ev[i].cpu,
+               ev[i].pid, names[ev[i].type], ev[i].arg);
+      else
+        timeline(&ev[i]);
+    }
+  }
+  exit();
+}
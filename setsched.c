@@ -0,0 +1,35 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "sched.h"
+
+static char *names[NSCHED] = {
+[SCHED_DEFAULT] "default",
+[SCHED_FCFS]    "fcfs",
+[SCHED_PBS]     "pbs",
+[SCHED_MLFQ]    "mlfq",
+[SCHED_CFS]     "cfs",
+[SCHED_STRIDE]  "stride",
+};
+
+// Print the scheduling policy, or switch to the named one.
+int
+main(int argc, char *argv[])
+{
+  int i, old;
+
+  if(argc < 2){
+    printf(1, "%s\n", names[setsched(-1)]);
+    exit();
+  }
+  for(i = 0; i < NSCHED; i++)
+    if(strcmp(argv[1], names[i]) == 0)
+      break;
+  if(i == NSCHED){
+    printf(2, "usage: setsched [default|fcfs|pbs|mlfq|cfs|stride]\n");
+    exit();
+  }
+  old = setsched(i);
+  printf(1, "%s -> %s\n", names[old], names[i]);
+  exit();
+}
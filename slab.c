@@ -0,0 +1,240 @@
+// Slab allocator for fixed-size kernel objects.
+//
+// Each object type gets a cache, which carves kalloc()
+// pages (slabs) into objects of its size.  A slab starts
+// with a header and holds its free objects on a list; it
+// is returned to kalloc() as soon as its last object is
+// freed, so a cache holds only about as many pages as its
+// live objects need.
+//
+// In front of the slabs, each CPU has a small magazine of
+// free objects per cache that it allocates from and frees
+// to without taking the cache lock.  Objects freed last are
+// allocated first, while they are still in the CPU's cache.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sysstat.h"
+
+#define NSLABCACHE 16  // caches
+#define NMAG        8  // objects per magazine
+
+struct obj {
+  struct obj *next;
+};
+
+struct slab {
+  struct slabcache *cache;
+  struct slab *next;           // On cache's partial list
+  struct slab *prev;
+  struct obj *free;            // Free objects in this slab
+  int inuse;                   // Objects allocated from it
+};
+
+struct magazine {
+  int n;
+  void *obj[NMAG];
+} __attribute__((aligned(64)));
+
+struct slabcache {
+  struct spinlock lock;
+  char *name;
+  uint size;                   // Object size, rounded up
+  uint perslab;                // Objects per slab
+  struct slab *partial;        // Slabs with free objects
+  uint nslabs;                 // Slabs held
+  uint nout;                   // Objects out of slabs, magazines included
+  struct magazine mag[NCPU];
+};
+
+struct {
+  struct spinlock lock;
+  struct slabcache cache[NSLABCACHE];
+  int n;
+} slabs;
+
+void
+slabinit(void)
+{
+  initlock(&slabs.lock, "slabs");
+}
+
+// Create a cache of objects of size bytes.
+struct slabcache*
+slabcreate(char *name, uint size)
+{
+  struct slabcache *c;
+
+  size = (size + 7) & ~7;
+  if(size < sizeof(struct obj) || size > PGSIZE - sizeof(struct slab))
+    panic("slabcreate: size");
+  acquire(&slabs.lock);
+  if(slabs.n == NSLABCACHE)
+    panic("slabcreate: too many");
+  c = &slabs.cache[slabs.n];
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - sizeof(struct slab)) / size;
+  slabs.n++;
+  release(&slabs.lock);
+  return c;
+}
+
+// The partial list.  Callers hold c->lock.
+
+static void
+partialinsert(struct slabcache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+partialremove(struct slabcache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Take an object from a slab, allocating a new
+// slab if none has room.  Caller holds c->lock.
+static void*
+objget(struct slabcache *c)
+{
+  struct slab *s;
+  struct obj *o;
+  char *v;
+  int i;
+
+  if((s = c->partial) == 0){
+    if((s = (struct slab*)kalloc()) == 0)
+      return 0;
+    s->cache = c;
+    s->inuse = 0;
+    s->free = 0;
+    v = (char*)(s + 1) + (c->perslab - 1) * c->size;
+    for(i = 0; i < c->perslab; i++, v -= c->size){
+      o = (struct obj*)v;
+      o->next = s->free;
+      s->free = o;
+    }
+    partialinsert(c, s);
+    c->nslabs++;
+  }
+  o = s->free;
+  s->free = o->next;
+  if(++s->inuse == c->perslab)
+    partialremove(c, s);
+  c->nout++;
+  return o;
+}
+
+// Return an object to its slab, giving the slab
+// back to kalloc() if it is now unused.
+// Caller holds c->lock.
+static void
+objput(struct slabcache *c, void *v)
+{
+  struct slab *s;
+  struct obj *o;
+
+  s = (struct slab*)PGROUNDDOWN((uint)v);
+  o = (struct obj*)v;
+  o->next = s->free;
+  s->free = o;
+  if(s->inuse-- == c->perslab)
+    partialinsert(c, s);
+  c->nout--;
+  if(s->inuse == 0){
+    partialremove(c, s);
+    c->nslabs--;
+    kfree((char*)s);
+  }
+}
+
+// Allocate an object from cache c.
+// Returns 0 if memory has run out.
+void*
+slaballoc(struct slabcache *c)
+{
+  struct magazine *m;
+  void *v;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    while(m->n < NMAG/2 && (v = objget(c)) != 0)
+      m->obj[m->n++] = v;
+    release(&c->lock);
+  }
+  v = m->n > 0 ? m->obj[--m->n] : 0;
+  popcli();
+  return v;
+}
+
+// Free an object allocated from cache c.
+void
+slabfree(struct slabcache *c, void *v)
+{
+  struct magazine *m;
+  int i;
+
+  if(((struct slab*)PGROUNDDOWN((uint)v))->cache != c)
+    panic("slabfree");
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == NMAG){
+    // Give back the half freed longest ago.
+    acquire(&c->lock);
+    for(i = 0; i < NMAG/2; i++)
+      objput(c, m->obj[i]);
+    release(&c->lock);
+    memmove(m->obj, m->obj + NMAG/2, (NMAG - NMAG/2) * sizeof(m->obj[0]));
+    m->n -= NMAG/2;
+  }
+  m->obj[m->n++] = v;
+  popcli();
+}
+
+// Report on cache i, or return -1 if there is none.
+// The magazine counts are read without locking.
+int
+slabstat(int i, struct slabstat *ss)
+{
+  struct slabcache *c;
+  int k;
+
+  acquire(&slabs.lock);
+  if(i < 0 || i >= slabs.n){
+    release(&slabs.lock);
+    return -1;
+  }
+  c = &slabs.cache[i];
+  release(&slabs.lock);
+
+  safestrcpy(ss->name, c->name, sizeof(ss->name));
+  ss->size = c->size;
+  ss->perslab = c->perslab;
+  ss->cached = 0;
+  for(k = 0; k < NCPU; k++)
+    ss->cached += c->mag[k].n;
+  acquire(&c->lock);
+  ss->slabs = c->nslabs;
+  ss->live = c->nout - ss->cached;
+  release(&c->lock);
+  return 0;
+}
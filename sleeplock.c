@@ -1,4 +1,12 @@
 // Sleeping locks
+//
+// A process waiting for a sleep lock lends its priority
+// and MLFQ level to the holder, so that under PBS or MLFQ
+// the holder is not starved by processes ranked between
+// the two.  Each lock remembers the best its waiters have
+// lent, and a holder inherits the best over all the locks
+// it holds.  Inheritance is not passed along when the
+// holder itself waits for another lock.
 
 #include "types.h"
 #include "defs.h"
@@ -10,6 +18,18 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 
+// Guards the waiters' loans: waitpri and waitlevel of every
+// lock and the inherited values of every process.  Taken
+// after a sleep lock's spinlock, and only when there are
+// waiters.
+static struct spinlock pilock;
+
+void
+sleeplockinit(void)
+{
+  initlock(&pilock, "pilock");
+}
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
@@ -17,26 +37,94 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->holder = 0;
+  lk->waitpri = lk->waitlevel = NOINHERIT;
+}
+
+// Lend p's priority and level to the holder of lk.
+// Caller must hold lk->lk and pilock.
+static void
+lend(struct sleeplock *lk, struct proc *p)
+{
+  struct proc *h = lk->holder;
+  int pri, level;
+
+  if(rqprio(p) < lk->waitpri)
+    lk->waitpri = rqprio(p);
+  if(rqlevel(p) < lk->waitlevel)
+    lk->waitlevel = rqlevel(p);
+  pri = h->inhpri < lk->waitpri ? h->inhpri : lk->waitpri;
+  level = h->inhlevel < lk->waitlevel ? h->inhlevel : lk->waitlevel;
+  rqinherit(h, pri, level);
+}
+
+// Recompute what p inherits from the locks it still holds.
+// Caller must hold pilock.
+static void
+unlend(struct proc *p)
+{
+  struct sleeplock *lk;
+  int pri, level;
+
+  pri = level = NOINHERIT;
+  for(lk = p->held; lk; lk = lk->nextheld){
+    if(lk->waitpri < pri)
+      pri = lk->waitpri;
+    if(lk->waitlevel < level)
+      level = lk->waitlevel;
+  }
+  rqinherit(p, pri, level);
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *p = myproc();
+  uint64 start;
+
   acquire(&lk->lk);
+  start = 0;
   while (lk->locked) {
+    acquire(&pilock);
+    if(start == 0 && rqoutranks(p, lk->holder)){
+      p->inversions++;
+      start = rdtsc();
+    }
+    lend(lk, p);
+    release(&pilock);
     sleep(lk, &lk->lk);
   }
+  if(start)
+    p->invtsc += rdtsc() - start;
   lk->locked = 1;
-  lk->pid = myproc()->pid;
+  lk->pid = p->pid;
+  lk->holder = p;
+  lk->nextheld = p->held;
+  p->held = lk;
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct proc *p = lk->holder;
+  struct sleeplock **pp;
+
   acquire(&lk->lk);
+  for(pp = &p->held; *pp != lk; pp = &(*pp)->nextheld)
+    ;
+  *pp = lk->nextheld;
+  // The waiters all wake, and those that lose
+  // the race lend to the next holder instead.
+  if(lk->waitpri != NOINHERIT || lk->waitlevel != NOINHERIT){
+    acquire(&pilock);
+    lk->waitpri = lk->waitlevel = NOINHERIT;
+    unlend(p);
+    release(&pilock);
+  }
   lk->locked = 0;
   lk->pid = 0;
+  lk->holder = 0;
   wakeup(lk);
   release(&lk->lk);
 }
@@ -2,6 +2,12 @@
 struct sleeplock {
   uint locked;       // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
+
+  // For priority inheritance:
+  struct proc *holder;         // Process holding lock
+  struct sleeplock *nextheld;  // Next lock held by holder
+  int waitpri;       // Best priority of a waiter, or NOINHERIT
+  int waitlevel;     // Best MLFQ level of a waiter, or NOINHERIT
   
   // For debugging:
   char *name;        // Name of lock.
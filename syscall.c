@@ -21,6 +21,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmtouch(curproc->pgdir, curproc->sz, addr, 4, 0) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -39,6 +41,9 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) &&
+       uvmfault(curproc->pgdir, curproc->sz, (uint)s, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -54,9 +59,13 @@ argint(int n, int *ip)
 
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
+// lies within the process address space, and fill in its
+// pages so that the kernel can read them, or write them if
+// write is set, without running out of memory in a page
+// fault.  Only blocks the kernel fills in are written, so
+// that others stay shared copy-on-write.
 int
-argptr(int n, char **pp, int size)
+argptr(int n, char **pp, int size, int write)
 {
   int i;
   struct proc *curproc = myproc();
@@ -65,6 +74,8 @@ argptr(int n, char **pp, int size)
     return -1;
   if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
     return -1;
+  if(uvmtouch(curproc->pgdir, curproc->sz, i, size, write) < 0)
+    return -1;
   *pp = (char*)i;
   return 0;
 }
@@ -105,8 +116,24 @@ extern int sys_waitx(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_cpr(void);
-extern int sys_cps(void);
+extern int sys_getprocs(void);
 extern int sys_getpinfo(void);
+extern int sys_settickets(void);
+extern int sys_gettickets(void);
+extern int sys_setrt(void);
+extern int sys_nanosleep(void);
+extern int sys_cpustat(void);
+extern int sys_traceread(void);
+extern int sys_setsched(void);
+extern int sys_waitstat(void);
+extern int sys_latstat(void);
+extern int sys_clone(void);
+extern int sys_join(void);
+extern int sys_futex_wait(void);
+extern int sys_futex_wake(void);
+extern int sys_yield_to(void);
+extern int sys_memstat(void);
+extern int sys_slabstat(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -132,8 +159,24 @@ static int (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_waitx]   sys_waitx,
 [SYS_cpr]     sys_cpr,
-[SYS_cps]     sys_cps,
+[SYS_getprocs] sys_getprocs,
 [SYS_getpinfo] sys_getpinfo,
+[SYS_settickets] sys_settickets,
+[SYS_gettickets] sys_gettickets,
+[SYS_setrt] sys_setrt,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_cpustat] sys_cpustat,
+[SYS_traceread] sys_traceread,
+[SYS_setsched] sys_setsched,
+[SYS_waitstat] sys_waitstat,
+[SYS_latstat] sys_latstat,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_yield_to] sys_yield_to,
+[SYS_memstat] sys_memstat,
+[SYS_slabstat] sys_slabstat,
 };
 
 void
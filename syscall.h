@@ -22,5 +22,21 @@
 #define SYS_close  21
 #define SYS_waitx  22
 #define SYS_cpr   23
-#define SYS_cps   24
+#define SYS_getprocs 24
 #define SYS_getpinfo 25
+#define SYS_settickets 26
+#define SYS_gettickets 27
+#define SYS_setrt 28
+#define SYS_nanosleep 29
+#define SYS_cpustat 30
+#define SYS_traceread 31
+#define SYS_setsched 32
+#define SYS_waitstat 33
+#define SYS_latstat 34
+#define SYS_clone  35
+#define SYS_join   36
+#define SYS_futex_wait 37
+#define SYS_futex_wake 38
+#define SYS_yield_to 39
+#define SYS_memstat 40
+#define SYS_slabstat 41
@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "trace.h"
+#include "sysstat.h"
 
 int
 sys_fork(void)
@@ -32,13 +34,115 @@ sys_waitx(void)
   int *wtime;
   int *rtime;
   
-  if(argptr(0, (char**)&wtime, sizeof(int)) < 0)
+  if(argptr(0, (char**)&wtime, sizeof(int), 1) < 0)
     return 12;
 
-  if(argptr(1, (char**)&rtime, sizeof(int)) < 0)
+  if(argptr(1, (char**)&rtime, sizeof(int), 1) < 0)
     return 13;
 
-  return waitx(wtime,rtime);
+  return waitx(wtime,rtime,0);
+}
+
+// Wait for a child like waitx, but report its
+// getpinfo statistics, TSC times included.
+int
+sys_waitstat(void)
+{
+  struct procstat *st;
+
+  if(argptr(0, (char**)&st, sizeof(*st), 1) < 0)
+    return -1;
+  return waitx(0, 0, st);
+}
+
+int
+sys_latstat(void)
+{
+  struct latstat *ls;
+  int pid, pol;
+
+  if(argint(0, &pid) < 0 || argint(1, &pol) < 0)
+    return -1;
+  if(argptr(2, (char**)&ls, sizeof(*ls), 1) < 0)
+    return -1;
+  return latstat(pid, pol, ls);
+}
+
+int
+sys_clone(void)
+{
+  int fn, arg;
+  char *stack;
+
+  if(argint(0, &fn) < 0 || argint(1, &arg) < 0)
+    return -1;
+  if(argptr(2, &stack, PGSIZE, 0) < 0)
+    return -1;
+  return clone((void(*)(void*))fn, (void*)arg, stack);
+}
+
+int
+sys_join(void)
+{
+  void **stack;
+
+  if(argptr(0, (char**)&stack, sizeof(*stack), 1) < 0)
+    return -1;
+  return join(stack);
+}
+
+int
+sys_futex_wait(void)
+{
+  char *addr;
+  int val;
+
+  if(argptr(0, &addr, sizeof(uint), 0) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futexwait((uint)addr, val);
+}
+
+int
+sys_futex_wake(void)
+{
+  char *addr;
+  int n;
+
+  if(argptr(0, &addr, sizeof(uint), 0) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futexwake((uint)addr, n);
+}
+
+int
+sys_yield_to(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return yieldto(pid);
+}
+
+int
+sys_memstat(void)
+{
+  struct memstat *ms;
+
+  if(argptr(0, (char**)&ms, sizeof(*ms), 1) < 0)
+    return -1;
+  kmemstat(ms);
+  return 0;
+}
+
+int
+sys_slabstat(void)
+{
+  int i;
+  struct slabstat *ss;
+
+  if(argint(0, &i) < 0 || argptr(1, (char**)&ss, sizeof(*ss), 1) < 0)
+    return -1;
+  return slabstat(i, ss);
 }
 
 int
@@ -75,21 +179,20 @@ int
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return timersleep(n);
+}
+
+int
+sys_nanosleep(void)
+{
+  int sec, nsec;
+
+  if(argint(0, &sec) < 0 || argint(1, &nsec) < 0)
+    return -1;
+  return nanosleep(sec, nsec);
 }
 
 // return how many clock tick interrupts have occurred
@@ -105,21 +208,71 @@ sys_uptime(void)
   return xticks;
 }
 
+// Copy a snapshot of the process table to the caller.
 int
-sys_cps(void)
+sys_getprocs(void)
 {
-    return cps();
+  struct pinfo *pi;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NPROC)
+    n = NPROC;
+  if(argptr(0, (char**)&pi, n*sizeof(*pi), 1) < 0)
+    return -1;
+  return getprocs((uint)pi, n);
 }
 
 int
 sys_getpinfo(void)
 {
   struct procstat *procstat;
-  if(argptr(0, (char**)&procstat, sizeof(int))<0)
+  if(argptr(0, (char**)&procstat, sizeof(*procstat), 1)<0)
     return -1;
   return getpinfo(procstat);
 }
 
+int
+sys_cpustat(void)
+{
+  struct cpustat *st;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > ncpu)
+    n = ncpu;
+  if(argptr(0, (char**)&st, n*sizeof(*st), 1) < 0)
+    return -1;
+  return cpustat(st, n);
+}
+
+int
+sys_traceread(void)
+{
+  struct traceev *ev;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NTRACE*ncpu)
+    n = NTRACE*ncpu;
+  if(argptr(0, (char**)&ev, n*sizeof(*ev), 1) < 0)
+    return -1;
+  return traceread((uint)ev, n);
+}
+
+int
+sys_setsched(void)
+{
+  int pol;
+
+  if(argint(0, &pol) < 0)
+    return -1;
+  return rqsetpolicy(pol);
+}
+
 int
 sys_cpr(void)
 {
@@ -131,3 +284,40 @@ sys_cpr(void)
 
     return cpr(pid, pr);
 }
+
+int
+sys_settickets(void)
+{
+    int pid, n;
+    if(argint(0, &pid) < 0)
+        return -1;
+    if(argint(1, &n) < 0)
+        return -1;
+
+    return settickets(pid, n);
+}
+
+int
+sys_gettickets(void)
+{
+    int pid;
+    if(argint(0, &pid) < 0)
+        return -1;
+
+    return gettickets(pid);
+}
+
+// Make the calling process real-time (runq.c).
+int
+sys_setrt(void)
+{
+    int runtime, period, deadline;
+    if(argint(0, &runtime) < 0)
+        return -1;
+    if(argint(1, &period) < 0)
+        return -1;
+    if(argint(2, &deadline) < 0)
+        return -1;
+
+    return rqsetrt(myproc(), runtime, period, deadline);
+}
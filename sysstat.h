@@ -0,0 +1,79 @@
+// Statistics the kernel reports to user programs through
+// system calls.  Included by both, after param.h, so that
+// the two agree on the layout.
+
+struct procstat{
+    int pid;
+    int runtime;
+    int num_run;
+    int current_queue;
+    int ticks[5];
+    int cpu;
+    int migrations;
+    int steals;
+    uint utime;                // Microseconds in user mode, from the TSC
+    uint stime;                // Microseconds in the kernel
+    uint wtime;                // Microseconds RUNNABLE waiting for a CPU
+  int inversions;            // Waits for a sleep lock held by a lower-ranked process
+  uint invtime;              // Microseconds spent in those waits
+};
+
+// Scheduling latency histograms reported by latstat().
+// Bucket 0 counts waits under a microsecond, bucket i
+// waits of 2^(i-1) up to 2^i microseconds, and the last
+// bucket everything longer.
+struct latstat {
+  struct procstat ps;          // The process's getpinfo statistics
+  uint run[NLAT];              // Its waits from RUNNABLE to RUNNING
+  uint wake[NLAT];             // Those that began with a wakeup
+  int policy;                  // Policy of the system-wide histograms
+  uint sysrun[NLAT];           // Every dispatch under that policy
+  uint syswake[NLAT];
+};
+
+// One process in the table snapshot taken by getprocs().
+struct pinfo {
+  int pid;
+  int ppid;                    // Parent's pid, 0 if none
+  int state;                   // enum procstate
+  int priority;
+  int level;                   // MLFQ level
+  int cpu;                     // CPU whose run queue it is on
+  int rtime;                   // Ticks run
+  int iotime;                  // Ticks slept
+  int num_run;                 // Times dispatched
+  int ticks[5];                // Ticks run at each MLFQ level
+  char name[16];
+};
+
+// Per-CPU scheduler counters reported by cpustat().
+struct cpustat {
+  int cpu;
+  uint idlems;                 // Milliseconds halted with nothing to run
+  uint halts;                  // Times it halted with nothing to run
+  uint ipis;                   // Reschedule IPIs received
+  uint steals;                 // Processes it took from other CPUs
+  uint migrations;             // Dispatches of processes last run elsewhere
+  int tickless;                // Timer stopped while idle
+  uint kallocs;                // Pages allocated on it
+  uint kfrees;                 // Pages freed on it
+};
+
+// Free memory statistics reported by memstat().
+struct memstat {
+  uint freepages;              // Pages free, cached ones included
+  uint cached;                 // Of those, in the per-CPU caches
+  int largest;                 // Order of the largest free block, or -1
+  uint nfree[NORDER];          // Free blocks of 2^n pages
+  uint fails[NORDER];          // Allocations of 2^n pages that failed
+};
+
+// Statistics of one slab cache, reported by slabstat().
+struct slabstat {
+  char name[16];
+  uint size;                   // Object size
+  uint perslab;                // Objects per slab
+  uint slabs;                  // Pages held
+  uint live;                   // Objects allocated
+  uint cached;                 // Free objects in per-CPU magazines
+};
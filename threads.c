@@ -0,0 +1,56 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NTHREAD 4
+#define NADD    10000
+
+static struct mutex lock;
+static struct cond alldone;
+static int total, done;
+
+// Threads add to a shared total under a mutex, and
+// the last one to finish signals the main thread.
+static void
+adder(void *arg)
+{
+  int i;
+
+  for(i = 0; i < NADD; i++){
+    mutex_lock(&lock);
+    total++;
+    mutex_unlock(&lock);
+  }
+  mutex_lock(&lock);
+  if(++done == NTHREAD)
+    cond_signal(&alldone);
+  mutex_unlock(&lock);
+}
+
+// Start threads that share this process's memory and
+// check that their work is all seen.
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  mutex_init(&lock);
+  cond_init(&alldone);
+  for(i = 0; i < NTHREAD; i++)
+    if(thread_create(adder, 0) < 0){
+      printf(2, "threads: thread_create failed\n");
+      exit();
+    }
+  mutex_lock(&lock);
+  while(done < NTHREAD)
+    cond_wait(&alldone, &lock);
+  mutex_unlock(&lock);
+  for(i = 0; i < NTHREAD; i++)
+    if(thread_join() < 0){
+      printf(2, "threads: thread_join failed\n");
+      exit();
+    }
+  printf(1, "threads: %d threads added %d, expected %d\n",
+         NTHREAD, total, NTHREAD * NADD);
+  exit();
+}
@@ -0,0 +1,20 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+int
+main(int argc, char *argv[])
+{
+    int pid;
+
+    if(argc < 2){
+        printf(2, "usage: tickets pid [tickets]\n");
+        exit();
+    }
+    pid = atoi(argv[1]);
+    if(argc > 2 && settickets(pid, atoi(argv[2])) < 0)
+        printf(2, "tickets: cannot set tickets of %d\n", pid);
+    printf(1, "%d: %d tickets\n", pid, gettickets(pid));
+    exit();
+}
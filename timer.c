@@ -0,0 +1,224 @@
+// Sleep timers.
+//
+// Processes sleeping for a time wait in a binary min-heap
+// ordered by the TSC value they are due, p->wakeat, and each
+// one sleeps on its own channel.  Every CPU's timer interrupt
+// wakes just the processes whose time has come, instead of
+// every sleeper rechecking the clock on every tick; with the
+// CPUs' timers out of phase, a sleep may end between ticks.
+//
+// The TSC is calibrated against the first TSCCAL ticks.
+// Until then, deadlines use the rate measured so far.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+
+#define TSCCAL 8                    // ticks to calibrate the TSC over
+#define TSCGUESS 10000000           // TSC cycles per tick before the first tick
+#define NSPERTICK (1000000000 / HZ)
+#define MAXSLEEP (0x7fffffff / HZ)  // longest nanosleep, in seconds
+
+struct {
+  struct spinlock lock;
+  struct proc *heap[NPROC];    // Sleeping processes, min-heap on wakeat
+  int n;
+} timers;
+
+uint tscpertick;               // TSC cycles per tick, 0 until calibrated
+static uint64 tsccal;          // TSC at the start of calibration
+
+void
+timerinit(void)
+{
+  initlock(&timers.lock, "timers");
+}
+
+// Deadlines are 64-bit TSC values, which do
+// not wrap, so a plain comparison orders them.
+static int
+dueless(struct proc *a, struct proc *b)
+{
+  return a->wakeat < b->wakeat;
+}
+
+static void
+heapset(int i, struct proc *p)
+{
+  timers.heap[i] = p;
+  p->timeridx = i;
+}
+
+static void
+heapup(int i)
+{
+  struct proc *p;
+  int parent;
+
+  p = timers.heap[i];
+  while(i > 0 && dueless(p, timers.heap[parent = (i-1)/2])){
+    heapset(i, timers.heap[parent]);
+    i = parent;
+  }
+  heapset(i, p);
+}
+
+static void
+heapdown(int i)
+{
+  struct proc *p;
+  int child;
+
+  p = timers.heap[i];
+  while((child = 2*i+1) < timers.n){
+    if(child+1 < timers.n && dueless(timers.heap[child+1], timers.heap[child]))
+      child++;
+    if(!dueless(timers.heap[child], p))
+      break;
+    heapset(i, timers.heap[child]);
+    i = child;
+  }
+  heapset(i, p);
+}
+
+static void
+heapremove(struct proc *p)
+{
+  struct proc *last;
+  int i;
+
+  i = p->timeridx;
+  p->timeridx = -1;
+  last = timers.heap[--timers.n];
+  if(last != p){
+    heapset(i, last);
+    heapdown(i);
+    heapup(last->timeridx);
+  }
+}
+
+// Called by every CPU's timer interrupt, on CPU 0 after
+// ticks has advanced: wake every process now due.
+void
+timertick(void)
+{
+  struct proc *p;
+  uint64 now;
+
+  now = rdtsc();
+  if(cpuid() == 0){
+    if(ticks == 1)
+      tsccal = now;
+    else if(ticks == 1 + TSCCAL)
+      tscpertick = (uint)(now - tsccal) / TSCCAL;
+  }
+
+  if(timers.n == 0)
+    return;
+  acquire(&timers.lock);
+  while(timers.n > 0 && timers.heap[0]->wakeat <= now){
+    p = timers.heap[0];
+    heapremove(p);
+    wakeup(&p->wakeat);
+  }
+  release(&timers.lock);
+}
+
+// TSC cycles per tick: calibrated, or the
+// best estimate so far before that.
+static uint
+tscrate(void)
+{
+  uint t;
+
+  if(tscpertick)
+    return tscpertick;
+  t = ticks;
+  if(t < 2)
+    return TSCGUESS;
+  return (uint)(rdtsc() - tsccal) / (t - 1);
+}
+
+// Convert TSC cycles to 1024ths of a tick, saturating.
+uint
+tscfrac(uint64 cyc)
+{
+  uint per;
+
+  per = tscrate() >> 10;
+  if(per == 0)
+    return 0;
+  if((uint)(cyc >> 32) >= per)
+    return ~0U;
+  return udiv64(cyc, per);
+}
+
+// Convert TSC cycles to microseconds, saturating,
+// or return 0 before the TSC has been calibrated.
+uint
+tscus(uint64 cyc)
+{
+  uint per;
+
+  per = tscpertick / (NSPERTICK / 1000);
+  if(per == 0)
+    return 0;
+  if((uint)(cyc >> 32) >= per)
+    return ~0U;
+  return udiv64(cyc, per);
+}
+
+// Sleep on the timer heap for cyc TSC cycles.
+// Return -1 if killed first.
+static int
+sleepcycles(uint64 cyc)
+{
+  struct proc *p = myproc();
+
+  acquire(&timers.lock);
+  if(cyc > 0 && !p->killed){
+    p->wakeat = rdtsc() + cyc;
+    heapset(timers.n, p);
+    heapup(timers.n++);
+    while(p->timeridx >= 0 && !p->killed)
+      sleep(&p->wakeat, &timers.lock);
+    if(p->timeridx >= 0)
+      heapremove(p);
+  }
+  release(&timers.lock);
+  return p->killed ? -1 : 0;
+}
+
+// Sleep until n more ticks have passed.
+// Return -1 if killed first.
+int
+timersleep(int n)
+{
+  if(n <= 0)
+    return myproc()->killed ? -1 : 0;
+  return sleepcycles((uint64)n * tscrate());
+}
+
+// Sleep for sec seconds and nsec nanoseconds, at most
+// MAXSLEEP seconds.  The part less than a tick has
+// microsecond resolution, and ends at the first timer
+// interrupt on any CPU after it is due.
+int
+nanosleep(int sec, int nsec)
+{
+  uint n, rate;
+  int rem;
+
+  if(sec < 0 || sec > MAXSLEEP || nsec < 0 || nsec >= 1000000000)
+    return -1;
+  n = (uint)sec * HZ + nsec / NSPERTICK;
+  rem = nsec % NSPERTICK;
+  rate = tscrate();
+  return sleepcycles((uint64)n * rate +
+                     (uint)(rem / 1000) * (rate / (NSPERTICK / 1000)));
+}
@@ -0,0 +1,58 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "sysstat.h"
+
+static char *states[] = {
+  "unused", "embryo", "sleep ", "runble", "run   ", "zombie"
+};
+
+static struct pinfo cur[NPROC], prev[NPROC];
+
+// Ticks p ran since the previous snapshot.
+static int
+delta(struct pinfo *p, int nprev)
+{
+  int i;
+
+  for(i = 0; i < nprev; i++)
+    if(prev[i].pid == p->pid)
+      return p->rtime - prev[i].rtime;
+  return p->rtime;
+}
+
+// Print the process table every interval ticks, count
+// times, with the share of a CPU each process used since
+// the last time.  usage: top [interval [count]]
+int
+main(int argc, char *argv[])
+{
+  int interval, count, i, n, nprev;
+
+  interval = argc > 1 ? atoi(argv[1]) : 100;
+  count = argc > 2 ? atoi(argv[2]) : 5;
+  if(interval <= 0){
+    printf(2, "usage: top [interval [count]]\n");
+    exit();
+  }
+  nprev = 0;
+  while(count-- > 0){
+    if((n = getprocs(cur, NPROC)) < 0){
+      printf(2, "top: getprocs failed\n");
+      exit();
+    }
+    printf(1, "\npid\tstate\tprio\tlevel\tcpu\t%%cpu\truns\tname\n");
+    for(i = 0; i < n; i++)
+      printf(1, "%d\t%s\t%d\t%d\t%d\t%d\t%d\t%s\n",
+             cur[i].pid, states[cur[i].state], cur[i].priority,
+             cur[i].level, cur[i].cpu,
+             nprev ? delta(&cur[i], nprev) * 100 / interval : 0,
+             cur[i].num_run, cur[i].name);
+    memmove(prev, cur, n * sizeof(cur[0]));
+    nprev = n;
+    if(count > 0)
+      sleep(interval);
+  }
+  exit();
+}
@@ -0,0 +1,94 @@
+// Scheduler event trace.
+//
+// Each CPU logs scheduler events into its own ring, with
+// interrupts off, so a ring has a single producer and logging
+// needs no lock: the producer fills the slot at head and then
+// advances head, and traceread() copies slots from tail up to
+// head and then advances tail.  A full ring drops new events
+// and counts them in lost.  Readers serialize on tracelock,
+// and copy events out to user memory only after releasing it.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "trace.h"
+
+#define TBATCH 32  // events copied out at a time
+
+struct tracering {
+  volatile uint head;          // Next slot to fill
+  volatile uint tail;          // Next slot to read
+  uint lost;                   // Events dropped while full
+  struct traceev ev[NTRACE];
+};
+
+static struct tracering rings[NCPU];
+static struct spinlock tracelock;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Log an event of type about p on this CPU's ring.
+void
+trace(int type, struct proc *p, int arg)
+{
+  struct tracering *r;
+  struct traceev *e;
+
+  pushcli();
+  r = &rings[cpuid()];
+  if(r->head - r->tail >= NTRACE){
+    r->lost++;
+    popcli();
+    return;
+  }
+  e = &r->ev[r->head % NTRACE];
+  e->tsc = rdtsc();
+  e->tick = ticks;
+  e->type = type;
+  e->cpu = cpuid();
+  e->pid = p->pid;
+  e->arg = arg;
+  __sync_synchronize();  // fill the slot before publishing it
+  r->head++;
+  popcli();
+}
+
+// Move up to n logged events, oldest first on each CPU,
+// to user address va, which the caller has checked.
+// Return the number moved, or -1 if copying out failed.
+int
+traceread(uint va, int n)
+{
+  struct traceev buf[TBATCH];
+  struct tracering *r;
+  struct proc *p = myproc();
+  int i, k, m;
+
+  for(m = 0; m < n; m += k){
+    acquire(&tracelock);
+    k = 0;
+    for(i = 0; i < ncpu; i++){
+      r = &rings[i];
+      while(k < TBATCH && m + k < n && r->tail != r->head){
+        buf[k++] = r->ev[r->tail % NTRACE];
+        __sync_synchronize();  // copy the slot before freeing it
+        r->tail++;
+      }
+    }
+    release(&tracelock);
+    if(k == 0)
+      break;
+    if(copyout(p->pgdir, p->sz, va + m*sizeof(buf[0]), buf, k*sizeof(buf[0])) < 0)
+      return -1;
+  }
+  return m;
+}
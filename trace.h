@@ -0,0 +1,17 @@
+// Scheduler trace events, as returned by traceread().
+#define TR_DISPATCH  1   // arg: priority it runs at
+#define TR_PREEMPT   2   // gave up the CPU still RUNNABLE
+#define TR_SLEEP     3
+#define TR_WAKEUP    4   // arg: CPU whose queue it joined
+#define TR_DEMOTE    5   // arg: new MLFQ level
+#define TR_PROMOTE   6   // arg: new MLFQ level
+#define TR_EXIT      7
+
+struct traceev {
+  uint64 tsc;                  // TSC of the CPU that logged it
+  uint tick;
+  ushort type;
+  ushort cpu;                  // CPU that logged it
+  int pid;
+  int arg;
+};
@@ -36,6 +36,11 @@ idtinit(void)
 void
 trap(struct trapframe *tf)
 {
+  // Time in user mode ends here, and in the kernel
+  // when we return to user mode.
+  if(myproc() && (tf->cs&3) == DPL_USER)
+    tsccharge(myproc(), &myproc()->utsc);
+
   if(tf->trapno == T_SYSCALL){
     if(myproc()->killed)
       exit();
@@ -43,6 +48,7 @@ trap(struct trapframe *tf)
     syscall();
     if(myproc()->killed)
       exit();
+    tsccharge(myproc(), &myproc()->stsc);
     return;
   }
 
@@ -51,15 +57,21 @@ trap(struct trapframe *tf)
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      wakeup(&ticks);
       release(&tickslock);
-      if(myproc()) {
-        if(myproc()->state == RUNNING)
-          myproc()->rtime++;
-        else if(myproc()->state == SLEEPING)
-          myproc()->iotime++;
-      }
     }
+    timertick();
+    // Every CPU's timer charges the process it is running.
+    if(myproc() && myproc()->state == RUNNING)
+      myproc()->rtime++;
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_RESCHED:
+    // Just wakes the idle loop, which looks at its queue again.
+    mycpu()->ipis++;
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_TLB:
+    tlbintr();
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -84,6 +96,20 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // A first touch of memory grown by sbrk, or a write to a
+    // copy-on-write page, from user space or from the kernel
+    // using user memory for a system call.
+    // System calls fill in the user memory they use first
+    // (see argptr), so a fault from the kernel here is rare.
+    // It can still happen, and panic below if memory has run
+    // out, when a thread sharing the memory forks or shrinks
+    // it between argptr and the kernel's use of it.
+    if(myproc() &&
+       uvmfault(myproc()->pgdir, myproc()->sz, rcr2(), tf->err & FEC_WR) == 0)
+      break;
+    // fall through
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -106,30 +132,17 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  #ifdef FCFS
-  //cprintf("kink\n");
-  #else
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU on clock tick,
+  // unless the policy never preempts (FCFS).
   // If interrupts were on while locks held, would need to check nlock.
-/*  #ifdef MLFQ
-  int clicks_per_queue[5]={1, 2, 4, 8, 16};
-  if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER){
-      if(myproc()->clicks==clicks_per_queue[myproc()->priority-1]){
-        myproc()->clicks=0;
-        yield();
-      }
-      else if(myproc()->clicks<clicks_per_queue[myproc()->priority-1])
-          myproc()->clicks++;
-  }
-  #else*/
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER && rqtick(myproc()))
     yield();
-//  #endif
-  #endif
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER){
     exit();
   }
+
+  if(myproc() && (tf->cs&3) == DPL_USER)
+    tsccharge(myproc(), &myproc()->stsc);
 }
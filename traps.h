@@ -22,6 +22,10 @@
 #define T_MCHK          18      // machine check
 #define T_SIMDERR       19      // SIMD floating point error
 
+// Page fault error code bits.
+#define FEC_PR         0x1      // page was present
+#define FEC_WR         0x2      // fault was a write
+
 // These are arbitrarily chosen, but with care not to overlap
 // processor defined exceptions or interrupt vectors.
 #define T_SYSCALL       64      // system call
@@ -34,5 +38,7 @@
 #define IRQ_COM1         4
 #define IRQ_IDE         14
 #define IRQ_ERROR       19
+#define IRQ_RESCHED     20      // IPI: work was queued for this CPU
+#define IRQ_TLB         21      // IPI: flush this CPU's TLB
 #define IRQ_SPURIOUS    31
 
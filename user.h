@@ -1,6 +1,12 @@
 struct stat;
 struct rtcdate;
 struct procstat;
+struct cpustat;
+struct pinfo;
+struct latstat;
+struct memstat;
+struct slabstat;
+struct traceev;
 
 // system calls
 int fork(void);
@@ -26,8 +32,24 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int cpr(int pid, int priority);
-int cps();
+int getprocs(struct pinfo *pi, int n);
 int getpinfo(struct procstat *procstat);
+int settickets(int pid, int tickets);
+int gettickets(int pid);
+int setrt(int runtime, int period, int deadline);
+int nanosleep(int sec, int nsec);
+int cpustat(struct cpustat *st, int n);
+int traceread(struct traceev *ev, int n);
+int setsched(int policy);
+int waitstat(struct procstat *st);
+int latstat(int pid, int policy, struct latstat *ls);
+int clone(void (*fn)(void*), void *arg, void *stack);
+int join(void **stack);
+int futex_wait(uint *addr, uint val);
+int futex_wake(uint *addr, int n);
+int yield_to(int pid);
+int memstat(struct memstat *ms);
+int slabstat(int i, struct slabstat *ss);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -42,3 +64,21 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+
+// uthread.c
+struct mutex {
+  uint state;  // 0 free, 1 held, 2 held with waiters
+};
+struct cond {
+  uint seq;    // bumped by every signal
+  uint nwait;  // threads in cond_wait
+};
+int thread_create(void (*fn)(void*), void *arg);
+int thread_join(void);
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
@@ -2,11 +2,13 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "sysstat.h"
 #include "fs.h"
 #include "fcntl.h"
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "sched.h"
 
 char buf[8192];
 char name[3];
@@ -1642,6 +1644,447 @@ bigargtest(void)
   unlink("bigarg-ok");
 }
 
+// can setsched() switch to every policy and back while
+// processes sit on the run queues, and does it refuse
+// policies that do not exist?
+void
+setschedtest(void)
+{
+  int i, pid, old, pol;
+  volatile int n;
+
+  printf(stdout, "setsched test\n");
+  old = setsched(-1);
+  if(old < 0 || old >= NSCHED){
+    printf(stdout, "setsched test failed: policy %d\n", old);
+    exit();
+  }
+  for(i = 0; i < 4; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(stdout, "fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      for(n = 0; n < 2000000; n++)
+        ;
+      exit();
+    }
+  }
+  for(pol = 0; pol < NSCHED; pol++){
+    if(setsched(pol) < 0 || setsched(-1) != pol){
+      printf(stdout, "setsched test failed: switch to %d\n", pol);
+      exit();
+    }
+    sleep(1);
+  }
+  if(setsched(NSCHED) != -1 || setsched(-2) != -1){
+    printf(stdout, "setsched test failed: bad policy accepted\n");
+    exit();
+  }
+  setsched(old);
+  for(i = 0; i < 4; i++){
+    if(wait() < 0){
+      printf(stdout, "setsched test failed: wait\n");
+      exit();
+    }
+  }
+  printf(stdout, "setsched test ok\n");
+}
+
+// does cpustat() report each CPU once, in order, and do
+// the halt counters move while this process sleeps?
+void
+cpustattest(void)
+{
+  struct cpustat st0[NCPU], st1[NCPU];
+  uint h0, h1;
+  int i, n;
+
+  printf(stdout, "cpustat test\n");
+  n = cpustat(st0, NCPU);
+  if(n < 1 || n > NCPU || cpustat(st0, 0) != 0){
+    printf(stdout, "cpustat test failed: %d cpus\n", n);
+    exit();
+  }
+  n = cpustat(st0, NCPU);
+  sleep(5);
+  if(cpustat(st1, NCPU) != n){
+    printf(stdout, "cpustat test failed: cpu count changed\n");
+    exit();
+  }
+  h0 = h1 = 0;
+  for(i = 0; i < n; i++){
+    if(st1[i].cpu != i){
+      printf(stdout, "cpustat test failed: entry %d is cpu %d\n",
+             i, st1[i].cpu);
+      exit();
+    }
+    h0 += st0[i].halts;
+    h1 += st1[i].halts;
+  }
+  if(h1 <= h0){
+    printf(stdout, "cpustat test failed: no halts while asleep\n");
+    exit();
+  }
+  printf(stdout, "cpustat test ok\n");
+}
+
+struct pinfo gpbuf[NPROC];
+
+// does getprocs() report this process and a sleeping
+// child under their pids, with the right parent?
+void
+getprocstest(void)
+{
+  int i, n, pid, fds[2], me, kid;
+  char c;
+
+  printf(stdout, "getprocs test\n");
+  if(pipe(fds) < 0){
+    printf(stdout, "pipe() failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    read(fds[0], &c, 1);
+    exit();
+  }
+  if(getprocs(gpbuf, 0) != 0){
+    printf(stdout, "getprocs test failed: n = 0\n");
+    exit();
+  }
+  n = getprocs(gpbuf, NPROC);
+  me = kid = 0;
+  for(i = 0; i < n; i++){
+    if(gpbuf[i].pid == getpid())
+      me = 1;
+    if(gpbuf[i].pid == pid && gpbuf[i].ppid == getpid())
+      kid = 1;
+  }
+  write(fds[1], "x", 1);
+  wait();
+  close(fds[0]);
+  close(fds[1]);
+  if(n < 3 || !me || !kid){
+    printf(stdout, "getprocs test failed: %d procs\n", n);
+    exit();
+  }
+  printf(stdout, "getprocs test ok\n");
+}
+
+char cowbuf[4096];
+
+// does a write after fork stay in the process that made it,
+// now that fork shares pages copy-on-write?
+void
+cowforktest(void)
+{
+  int pid, p1[2], p2[2];
+  char c;
+
+  printf(stdout, "cow fork test\n");
+  memset(cowbuf, 'a', sizeof(cowbuf));
+  if(pipe(p1) < 0 || pipe(p2) < 0){
+    printf(stdout, "pipe() failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    cowbuf[0] = 'c';
+    write(p1[1], "x", 1);
+    read(p2[0], &c, 1);  // parent has written its copy
+    c = cowbuf[0] == 'c' && cowbuf[1] == 'a' ? 'y' : 'n';
+    write(p1[1], &c, 1);
+    exit();
+  }
+  read(p1[0], &c, 1);  // child has written its copy
+  if(cowbuf[0] != 'a'){
+    printf(stdout, "cow fork test failed\n");
+    exit();
+  }
+  cowbuf[1] = 'p';
+  write(p2[1], "x", 1);
+  if(read(p1[0], &c, 1) != 1 || c != 'y'){
+    printf(stdout, "cow fork test failed\n");
+    exit();
+  }
+  wait();
+  close(p1[0]);
+  close(p1[1]);
+  close(p2[0]);
+  close(p2[1]);
+  printf(stdout, "cow fork test ok\n");
+}
+
+// can read() fill memory from sbrk() that was never touched,
+// which the kernel has to map before copying into it? and
+// does that memory come back zeroed after sbrk() shrinks
+// and regrows?
+void
+sbrklazytest(void)
+{
+  char *a, *p;
+  int fd, i, n;
+
+  printf(stdout, "sbrk lazy test\n");
+  a = sbrk(sizeof(buf));
+  fd = open("README", O_RDONLY);
+  n = read(fd, a, sizeof(buf));
+  close(fd);
+  fd = open("README", O_RDONLY);
+  if(a == (char*)-1 || n <= 0 || read(fd, buf, sizeof(buf)) != n)
+    goto bad;
+  close(fd);
+  for(i = 0; i < n; i++)
+    if(a[i] != buf[i])
+      goto bad;
+
+  // The page a starts in is kept; the rest are freed.
+  if(sbrk(-sizeof(buf)) == (char*)-1 || sbrk(sizeof(buf)) != a)
+    goto bad;
+  for(p = (char*)(((uint)a + 4095) & ~4095); p < a + sizeof(buf); p++)
+    if(*p != 0)
+      goto bad;
+  sbrk(-sizeof(buf));
+  printf(stdout, "sbrk lazy test ok\n");
+  return;
+
+bad:
+  printf(stdout, "sbrk lazy test failed\n");
+  exit();
+}
+
+int tfd;
+
+void
+fdthread(void *arg)
+{
+  tfd = open("threadfile", O_CREATE|O_RDWR);
+  chdir("threaddir");
+}
+
+// do threads from clone() share their open files and
+// current directory?
+void
+threadtest(void)
+{
+  int fd;
+
+  printf(stdout, "thread test\n");
+  tfd = -1;
+  if(mkdir("threaddir") < 0 || thread_create(fdthread, 0) < 0){
+    printf(stdout, "thread test failed: setup\n");
+    exit();
+  }
+  if(thread_join() < 0 || thread_join() != -1){
+    printf(stdout, "thread test failed: join\n");
+    exit();
+  }
+  if(tfd < 0 || write(tfd, "x", 1) != 1){
+    printf(stdout, "thread test failed: open file not shared\n");
+    exit();
+  }
+  close(tfd);
+  fd = open("dirfile", O_CREATE|O_RDWR);
+  close(fd);
+  if((fd = open("/threaddir/dirfile", 0)) < 0){
+    printf(stdout, "thread test failed: cwd not shared\n");
+    exit();
+  }
+  close(fd);
+  unlink("dirfile");
+  chdir("/");
+  unlink("threadfile");
+  unlink("threaddir");
+  printf(stdout, "thread test ok\n");
+}
+
+#define NTHREAD 4
+#define NCOUNT 10000
+
+struct mutex countlock;
+int counter;
+uint fword;
+volatile int fready, fdone;
+
+void
+countthread(void *arg)
+{
+  int i;
+
+  for(i = 0; i < NCOUNT; i++){
+    mutex_lock(&countlock);
+    counter++;
+    mutex_unlock(&countlock);
+  }
+}
+
+void
+futexwaiter(void *arg)
+{
+  fready = 1;
+  while(fword == 0)
+    futex_wait(&fword, 0);
+  fdone = 1;
+}
+
+// does the futex mutex keep threads' updates from being
+// lost? and does futex_wake() still find a waiter once
+// fork() has made the futex's page copy-on-write?
+void
+futextest(void)
+{
+  int i, pid;
+
+  printf(stdout, "futex test\n");
+  mutex_init(&countlock);
+  counter = 0;
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_create(countthread, 0) < 0){
+      printf(stdout, "thread_create failed\n");
+      exit();
+    }
+  }
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_join() < 0){
+      printf(stdout, "futex test failed: join\n");
+      exit();
+    }
+  }
+  if(counter != NTHREAD*NCOUNT){
+    printf(stdout, "futex test failed: count %d\n", counter);
+    exit();
+  }
+
+  fword = 0;
+  if(thread_create(futexwaiter, 0) < 0){
+    printf(stdout, "thread_create failed\n");
+    exit();
+  }
+  while(!fready)
+    sleep(1);
+  sleep(2);  // let it block in futex_wait
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0)
+    exit();
+  wait();
+  fword = 1;
+  for(i = 0; i < 100 && !fdone; i++){
+    futex_wake(&fword, 1);
+    sleep(1);
+  }
+  if(!fdone){
+    printf(stdout, "futex test failed: wakeup lost after fork\n");
+    exit();
+  }
+  thread_join();
+  printf(stdout, "futex test ok\n");
+}
+
+// do memstat()'s counts add up, and do pages that a
+// process touches leave the free count and come back
+// when it shrinks?
+void
+memstattest(void)
+{
+  struct memstat m0, m1, m2;
+  char *a;
+  uint sum;
+  int i;
+
+  printf(stdout, "memstat test\n");
+  if(memstat(&m0) < 0){
+    printf(stdout, "memstat test failed: call\n");
+    exit();
+  }
+  sum = m0.cached;
+  for(i = 0; i < NORDER; i++)
+    sum += m0.nfree[i] << i;
+  if(m0.freepages == 0 || sum != m0.freepages ||
+     m0.largest < 0 || m0.largest >= NORDER){
+    printf(stdout, "memstat test failed: %d free, %d counted\n",
+           m0.freepages, sum);
+    exit();
+  }
+  a = sbrk(64*4096);
+  if(a == (char*)-1){
+    printf(stdout, "sbrk failed\n");
+    exit();
+  }
+  for(i = 0; i < 64; i++)
+    a[i*4096] = 1;
+  memstat(&m1);
+  sbrk(-64*4096);
+  memstat(&m2);
+  if(m1.freepages + 64 > m0.freepages || m2.freepages < m1.freepages + 64){
+    printf(stdout, "memstat test failed: %d %d %d free\n",
+           m0.freepages, m1.freepages, m2.freepages);
+    exit();
+  }
+  printf(stdout, "memstat test ok\n");
+}
+
+// does slabstat() list the pipe cache, and does its live
+// count follow pipes being made and closed?
+void
+slabstattest(void)
+{
+  struct slabstat ss;
+  uint live;
+  int i, k, fds[8][2];
+
+  printf(stdout, "slabstat test\n");
+  for(i = 0; slabstat(i, &ss) == 0; i++)
+    if(strcmp(ss.name, "pipe") == 0)
+      break;
+  if(strcmp(ss.name, "pipe") != 0 || ss.size == 0 || ss.perslab == 0){
+    printf(stdout, "slabstat test failed: no pipe cache\n");
+    exit();
+  }
+  if(slabstat(-1, &ss) != -1){
+    printf(stdout, "slabstat test failed: bad index accepted\n");
+    exit();
+  }
+  slabstat(i, &ss);
+  live = ss.live;
+  for(k = 0; k < 8; k++){
+    if(pipe(fds[k]) < 0){
+      printf(stdout, "pipe() failed\n");
+      exit();
+    }
+  }
+  slabstat(i, &ss);
+  if(ss.live != live + 8 || ss.slabs == 0){
+    printf(stdout, "slabstat test failed: %d live, want %d\n",
+           ss.live, live + 8);
+    exit();
+  }
+  for(k = 0; k < 8; k++){
+    close(fds[k][0]);
+    close(fds[k][1]);
+  }
+  slabstat(i, &ss);
+  if(ss.live != live){
+    printf(stdout, "slabstat test failed: %d live, want %d\n",
+           ss.live, live);
+    exit();
+  }
+  printf(stdout, "slabstat test ok\n");
+}
+
 // what happens when the file system runs out of blocks?
 // answer: balloc panics, so this test is not useful.
 void
@@ -1769,6 +2212,15 @@ main(int argc, char *argv[])
   bsstest();
   sbrktest();
   validatetest();
+  cpustattest();
+  setschedtest();
+  getprocstest();
+  cowforktest();
+  sbrklazytest();
+  threadtest();
+  futextest();
+  memstattest();
+  slabstattest();
 
   opentest();
   writetest();
@@ -0,0 +1,132 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "mmu.h"
+#include "x86.h"
+
+// Threads on top of clone() and join(), and locks and
+// condition variables on top of futexes.  Each thread runs
+// on a PGSIZE stack from malloc(), which is not itself safe
+// to call from two threads at once.
+
+struct start {
+  void (*fn)(void*);
+  void *arg;
+};
+
+// Threads begin here, with the function to run kept at the
+// bottom of their stack, and exit when it returns.
+static void
+threadstart(void *stack)
+{
+  struct start *s = stack;
+
+  s->fn(s->arg);
+  exit();
+}
+
+// Start a thread running fn(arg).  Return its pid, or -1.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  struct start *s;
+  void *stack;
+  int pid;
+
+  if((stack = malloc(PGSIZE)) == 0)
+    return -1;
+  s = stack;
+  s->fn = fn;
+  s->arg = arg;
+  if((pid = clone(threadstart, stack, stack)) < 0)
+    free(stack);
+  return pid;
+}
+
+// Wait for a thread started by this one to exit, and free
+// its stack.  Return its pid, or -1 if there are none.
+int
+thread_join(void)
+{
+  void *stack;
+  int pid;
+
+  if((pid = join(&stack)) >= 0)
+    free(stack);
+  return pid;
+}
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+// Take m.  A free mutex is taken without entering the
+// kernel; otherwise mark it contended and sleep until
+// it is handed back.
+void
+mutex_lock(struct mutex *m)
+{
+  uint c;
+
+  if((c = cmpxchg(&m->state, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = xchg(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = xchg(&m->state, 2);
+  }
+}
+
+// Release m, and wake a waiter only if there may be one.
+void
+mutex_unlock(struct mutex *m)
+{
+  if(xchg(&m->state, 0) == 2)
+    futex_wake(&m->state, 1);
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+  c->nwait = 0;
+}
+
+// Release m and sleep until signalled, then take m again.
+// Like any condition variable it can wake spuriously.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  uint seq;
+
+  xadd(&c->nwait, 1);
+  seq = c->seq;
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  xadd(&c->nwait, -1);
+  // Others may be queued behind us, so take
+  // m as contended.
+  while(xchg(&m->state, 2) != 0)
+    futex_wait(&m->state, 2);
+}
+
+// Wake one thread in cond_wait, if any.
+void
+cond_signal(struct cond *c)
+{
+  xadd(&c->seq, 1);
+  if(c->nwait)
+    futex_wake(&c->seq, 1);
+}
+
+// Wake every thread in cond_wait.
+void
+cond_broadcast(struct cond *c)
+{
+  xadd(&c->seq, 1);
+  if(c->nwait)
+    futex_wake(&c->seq, c->nwait);
+}
@@ -2,14 +2,20 @@
 #include "types.h"
 #include "defs.h"
 #include "x86.h"
+#include "traps.h"
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "spinlock.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
 
+// Serializes page faults, so that two threads touching
+// the same page do not both fill it in or copy it.
+static struct spinlock faultlock;
+
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
 void
@@ -140,6 +146,7 @@ setupkvm(void)
 void
 kvmalloc(void)
 {
+  initlock(&faultlock, "fault");
   kpgdir = setupkvm();
   switchkvm();
 }
@@ -173,10 +180,55 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
+  mycpu()->pgdir = p->pgdir;  // before loading it; see tlbshootdown
   lcr3(V2P(p->pgdir));  // switch to process's address space
   popcli();
 }
 
+// Flush the TLBs of all CPUs running on pgdir, the current
+// page table, after mappings in it were removed or made
+// read-only, and wait until they have: threads sharing it
+// may be running elsewhere.  The caller must not hold a
+// spinlock, since a CPU spinning for it with interrupts
+// off cannot take the IPI.
+void
+tlbshootdown(pde_t *pgdir)
+{
+  struct cpu *c;
+  uint want[NCPU];
+  int sent[NCPU];
+
+  __sync_synchronize();  // publish the PTEs before reading c->pgdir
+  pushcli();
+  lcr3(rcr3());
+  for(c = cpus; c < cpus+ncpu; c++){
+    sent[c-cpus] = c != mycpu() && c->pgdir == pgdir;
+    if(!sent[c-cpus])
+      continue;
+    want[c-cpus] = __sync_add_and_fetch(&c->tlbreq, 1);
+    lapicipi(c->apicid, T_IRQ0 + IRQ_TLB);
+  }
+  popcli();
+
+  // A CPU that has switched page tables since has flushed.
+  for(c = cpus; c < cpus+ncpu; c++)
+    while(sent[c-cpus] && c->pgdir == pgdir &&
+          (int)(c->tlbdone - want[c-cpus]) < 0)
+      ;
+}
+
+// Flush this CPU's TLB for tlbshootdown().
+void
+tlbintr(void)
+{
+  struct cpu *c = mycpu();
+  uint req;
+
+  req = c->tlbreq;
+  lcr3(rcr3());
+  c->tlbdone = req;
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -278,6 +330,42 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   return newsz;
 }
 
+// Shrink the memory of a process, whose threads may be
+// running on other CPUs, from oldsz to newsz.  The pages
+// are unmapped and every TLB flushed before any is freed,
+// so that no CPU can still reach a page once it is reused.
+// The caller has lowered the process size already, so that
+// uvmfault() leaves the range alone, and holds no spinlock.
+void
+shrinkuvm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  pte_t *pte;
+  uint a;
+
+  // Mark the pages not present, keeping their addresses.
+  acquire(&faultlock);
+  for(a = PGROUNDUP(newsz); a < oldsz; a += PGSIZE){
+    if((pte = walkpgdir(pgdir, (char*)a, 0)) == 0)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else
+      *pte &= ~PTE_P;
+  }
+  release(&faultlock);
+
+  tlbshootdown(pgdir);
+
+  acquire(&faultlock);
+  for(a = PGROUNDUP(newsz); a < oldsz; a += PGSIZE){
+    if((pte = walkpgdir(pgdir, (char*)a, 0)) == 0)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if(PTE_ADDR(*pte) != 0){
+      kfree(P2V(PTE_ADDR(*pte)));
+      *pte = 0;
+    }
+  }
+  release(&faultlock);
+}
+
 // Free a page table and all the physical memory pages
 // in the user part.
 void
@@ -310,37 +398,119 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
-// Given a parent process's page table, create a copy
-// of it for a child.
+// Given a parent process's page table, which must be the
+// current one, create a copy of it for a child.  The pages
+// themselves are shared: writable ones become read-only and
+// copy-on-write in both, and uvmfault() copies one when it
+// is first written.  Pages never touched stay unmapped.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
   pte_t *pte;
   uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
+  acquire(&faultlock);  // threads may be faulting in pgdir
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0 || !(*pte & PTE_P))
+      continue;
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
       goto bad;
-    }
+    kdup(P2V(pa));
   }
+  release(&faultlock);
+  tlbshootdown(pgdir);  // flush the parent's writable mappings
   return d;
 
 bad:
+  release(&faultlock);
   freevm(d);
+  tlbshootdown(pgdir);
+  return 0;
+}
+
+// Make the page at pte, mapped at va, writable, first
+// copying it if it is shared copy-on-write.
+// Caller holds faultlock.
+static int
+cowcopy(pte_t *pte, uint va)
+{
+  char *mem, *old;
+
+  if((*pte & PTE_COW) == 0)
+    return -1;
+  old = P2V(PTE_ADDR(*pte));
+  if(krefs(old) > 1){
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, old, PGSIZE);
+    *pte = V2P(mem) | PTE_FLAGS(*pte);
+    kfree(old);
+  }
+  *pte = (*pte & ~PTE_COW) | PTE_W;
+  invlpg((void*)va);
+  return 0;
+}
+
+// Make user address va accessible, on a page fault or
+// before the kernel writes it through its own mapping.
+// A page never touched gets a zeroed page, since growproc()
+// only reserves address space, and for a write, a page
+// shared copy-on-write is copied.  Return -1 if va is not
+// below the process size sz, the access is not allowed or
+// memory has run out.
+int
+uvmfault(pde_t *pgdir, uint sz, uint va, int write)
+{
+  pte_t *pte;
+  char *mem;
+  int r;
+
+  if(va >= sz || va >= KERNBASE)
+    return -1;
+  va = PGROUNDDOWN(va);
+  r = 0;
+  acquire(&faultlock);
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  if(pte == 0 || (*pte & PTE_P) == 0){
+    if((mem = kalloc()) == 0)
+      r = -1;
+    else {
+      memset(mem, 0, PGSIZE);
+      if(mappages(pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+        kfree(mem);
+        r = -1;
+      }
+    }
+  } else if((*pte & PTE_U) == 0)
+    r = -1;
+  else if(write && (*pte & PTE_W) == 0)
+    r = cowcopy(pte, va);
+  release(&faultlock);
+  return r;
+}
+
+// Make the len bytes of user memory at va accessible as
+// uvmfault() does, before the kernel uses them through
+// the user mapping: a page fault in the kernel that runs
+// out of memory has no one to return an error to.
+// Return -1 if they do not all lie below sz.
+int
+uvmtouch(pde_t *pgdir, uint sz, uint va, uint len, int write)
+{
+  uint a;
+
+  if(va > sz || len > sz - va)
+    return -1;
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE)
+    if(uvmfault(pgdir, sz, a, write) < 0)
+      return -1;
   return 0;
 }
 
@@ -352,25 +522,31 @@ uva2ka(pde_t *pgdir, char *uva)
   pte_t *pte;
 
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
   return (char*)P2V(PTE_ADDR(*pte));
 }
 
-// Copy len bytes from p to user address va in page table pgdir.
+// Copy len bytes from p to user address va in page table pgdir,
+// whose process has size sz.
 // Most useful when pgdir is not the current page table.
-// uva2ka ensures this only works for PTE_U pages.
+// uvmfault ensures this only works for PTE_U pages, filling
+// in untouched pages and copying shared ones first.
 int
-copyout(pde_t *pgdir, uint va, void *p, uint len)
+copyout(pde_t *pgdir, uint sz, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
 
+  if(va > sz || len > sz - va)
+    return -1;
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    if(uvmfault(pgdir, sz, va0, 1) < 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;